@@ -0,0 +1,146 @@
+#include "Analysis.h"
+
+#include <set>
+
+
+namespace {
+
+    OpCode opAt(Bytes<4096> const& memory, Word address)
+    {
+        return memory[address] << 8 | memory[address + 1];
+    }
+
+    // every address the instruction at 'pc' can continue at, as far as it's known statically
+    std::vector<Word> targets(OpCode op, Word pc)
+    {
+        const Word next = pc + 2;
+        switch (flow(op)) {
+        case Flow::Next:
+        case Flow::Write:    return { next };
+        case Flow::Jump:     return { Word(op & 0x0FFF) };
+        case Flow::Call:     return { Word(op & 0x0FFF), next };
+        case Flow::Skip:     return { next, Word(pc + 4) };
+        case Flow::Wait:     return { pc, next };
+        case Flow::Return:
+        case Flow::Indirect:
+        case Flow::Unknown:  return {};
+        }
+        return {};
+    }
+
+    bool inMemory(Word address)
+    {
+        return address + 1 < 4096;
+    }
+
+}
+
+Flow flow(OpCode op)
+{
+    switch (op & 0xF000) {
+    case 0x0000:
+        if (op == 0x00E0) { return Flow::Next; }
+        if (op == 0x00EE) { return Flow::Return; }
+        return Flow::Unknown;
+    case 0x1000: return Flow::Jump;
+    case 0x2000: return Flow::Call;
+    case 0x3000:
+    case 0x4000: return Flow::Skip;
+    case 0x5000:
+    case 0x9000: return (op & 0x000F) == 0 ? Flow::Skip : Flow::Unknown;
+    case 0x6000:
+    case 0x7000:
+    case 0xA000:
+    case 0xC000:
+    case 0xD000: return Flow::Next;
+    case 0x8000:
+        switch (op & 0x000F) {
+        case 0x0: case 0x1: case 0x2: case 0x3:
+        case 0x4: case 0x5: case 0x6: case 0x7:
+        case 0xE: return Flow::Next;
+        }
+        return Flow::Unknown;
+    case 0xB000: return Flow::Indirect;
+    case 0xE000:
+        return (op & 0x00FF) == 0x9E || (op & 0x00FF) == 0xA1 ? Flow::Skip : Flow::Unknown;
+    case 0xF000:
+        switch (op & 0x00FF) {
+        case 0x07: case 0x15: case 0x18: case 0x1E: case 0x29: case 0x65: return Flow::Next;
+        case 0x0A: return Flow::Wait;
+        case 0x33: case 0x55: return Flow::Write;
+        }
+        return Flow::Unknown;
+    }
+    return Flow::Unknown;
+}
+
+ControlFlow analyze(Bytes<4096> const& memory, Word entry)
+{
+    // 1. every reachable instruction, and the addresses something jumps to (leaders)
+    std::set<Word> instructions;
+    std::set<Word> leaders = { entry };
+    std::vector<Word> work = { entry };
+
+    ControlFlow result;
+    while (!work.empty()) {
+        Word pc = work.back();
+        work.pop_back();
+
+        while (inMemory(pc) && !instructions.count(pc)) {
+            const OpCode op = opAt(memory, pc);
+            const Flow f = flow(op);
+            if (f == Flow::Unknown) {
+                break;
+            }
+
+            instructions.insert(pc);
+            result.indirect |= f == Flow::Indirect;
+            if (f == Flow::Next) {
+                pc += 2;
+                continue;
+            }
+
+            // anything else ends the block, all its successors start one
+            for (Word target : targets(op, pc)) {
+                leaders.insert(target);
+                work.push_back(target);
+            }
+            break;
+        }
+    }
+
+    // 2. blocks run from a leader up to the first control flow change or the next leader
+    for (Word leader : leaders) {
+        if (!instructions.count(leader)) {
+            continue;
+        }
+
+        BasicBlock block;
+        block.start = leader;
+
+        Word pc = leader;
+        for (;;) {
+            const OpCode op = opAt(memory, pc);
+            const Flow f = flow(op);
+            result.code.set(pc);
+            result.code.set(pc + 1);
+            pc += 2;
+
+            if (f != Flow::Next) {
+                block.successors = targets(op, pc - 2);
+                break;
+            }
+            if (!instructions.count(pc) || leaders.count(pc)) {
+                if (instructions.count(pc)) {
+                    block.successors = { pc };
+                }
+                break;
+            }
+        }
+
+        block.end = pc;
+        result.blocks[leader] = block;
+    }
+
+    return result;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <bitset>
+#include <map>
+#include <vector>
+
+#include "Chip8.h"
+
+// Static analysis of a rom: which bytes are code and how they are connected.
+// The instructions are found by following every statically known path from the entry point,
+// the paths behind Bnnn (and 00EE into unknown callers) can't be followed.
+
+// what an opcode does to the control flow
+enum class Flow {
+    Next,     // continues with the next instruction
+    Jump,     // 1nnn
+    Call,     // 2nnn, continues at nnn and later after the 2nnn
+    Return,   // 00EE
+    Skip,     // 3xnn, 4xnn, 5xy0, 9xy0, Ex9E, ExA1: next or next but one
+    Indirect, // Bnnn, the target is only known at runtime
+    Wait,     // Fx0A, repeats itself until a key is pressed
+    Write,    // Fx33, Fx55: continues with the next instruction, but may have overwritten it
+    Unknown   // not an instruction, analysis stops here
+};
+
+Flow flow(OpCode op);
+
+// a straight run of instructions, only the last one may change the control flow or write memory
+struct BasicBlock {
+    Word start = 0;
+    Word end   = 0; // first byte after the last instruction
+    std::vector<Word> successors; // statically known, in no particular order
+
+    std::size_t size() const { return (end - start) / 2; }
+};
+
+struct ControlFlow {
+    std::map<Word, BasicBlock> blocks; // by start address
+    std::bitset<4096> code;            // bytes that belong to an instruction of a block
+    bool indirect = false;             // there is at least one Bnnn, some code may be missing
+};
+
+ControlFlow analyze(Bytes<4096> const& memory, Word entry = Chip8::StartAddress);
@@ -0,0 +1,284 @@
+// Ahead-of-time translation of a rom into C++, no SDL involved.
+//
+//   chip8-aot [--dialect NAME] rom [-o out.cpp]
+//
+//   --dialect NAME vip, chip48, schip or modern (default modern)
+//   -o FILE        write the source to FILE instead of stdout
+//
+// Every basic block found by analyze() becomes a function on Chip8. Register, jump and skip opcodes
+// are written out as plain C++, the compiler can inline and optimize them; everything else calls
+// the normal handler. The generated source implements AotProgram.h, AotRunner.cpp turns it into
+// a standalone runner. Code that isn't found statically (behind Bnnn, ...) and everything after a
+// write into translated code is interpreted by the runner.
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Analysis.h"
+#include "Dialects.h"
+
+
+namespace {
+
+    void usage()
+    {
+        std::cout << "usage: chip8-aot [--dialect vip|chip48|schip|modern] rom [-o out.cpp]\n";
+    }
+
+    std::string hex(int value, int digits)
+    {
+        std::ostringstream s;
+        s << "0x" << std::hex << std::uppercase << std::setfill('0') << std::setw(digits) << value;
+        return s.str();
+    }
+
+    std::string name(Word address)
+    {
+        return hex(address, 3).substr(2);
+    }
+
+    std::string reg(int n)
+    {
+        return "c.V[" + hex(n, 1) + "]";
+    }
+
+    // handlers that read or change PC get it already moved to the next instruction, like in Chip8::execute
+    bool usesPC(OpCode op)
+    {
+        const Flow f = flow(op);
+        return f == Flow::Call || f == Flow::Return || f == Flow::Indirect || f == Flow::Wait || (op & 0xF000) == 0xE000;
+    }
+
+    // C++ for the instruction at 'pc'; empty if the handler has to be called
+    std::string inlined(OpCode op, Word pc)
+    {
+        const int x   = (op & 0x0F00) >> 8;
+        const int y   = (op & 0x00F0) >> 4;
+        const int nn  = op & 0x00FF;
+        const int nnn = op & 0x0FFF;
+        const std::string next = hex(pc + 2, 3);
+        const std::string skip = hex(pc + 4, 3);
+
+        // the same order of reads and writes as in the handlers, VF may be x or y
+        switch (op & 0xF000) {
+        case 0x1000: return "c.PC = " + hex(nnn, 3) + ";";
+        case 0x3000: return "c.PC = " + reg(x) + " == " + hex(nn, 2) + " ? " + skip + " : " + next + ";";
+        case 0x4000: return "c.PC = " + reg(x) + " != " + hex(nn, 2) + " ? " + skip + " : " + next + ";";
+        case 0x5000: return "c.PC = " + reg(x) + " == " + reg(y) + " ? " + skip + " : " + next + ";";
+        case 0x9000: return "c.PC = " + reg(x) + " != " + reg(y) + " ? " + skip + " : " + next + ";";
+        case 0x6000: return reg(x) + " = " + hex(nn, 2) + ";";
+        case 0x7000: return reg(x) + " = Byte(" + reg(x) + " + " + hex(nn, 2) + ");";
+        case 0xA000: return "c.I = " + hex(nnn, 3) + ";";
+        case 0x8000:
+            switch (op & 0x000F) {
+            case 0x0: return reg(x) + " = " + reg(y) + ";";
+            case 0x4: return "c.V[0xF] = " + reg(x) + " + " + reg(y) + " > 255 ? 1 : 0; " + reg(x) + " += " + reg(y) + ";";
+            case 0x5: return "c.V[0xF] = " + reg(x) + " > " + reg(y) + " ? 1 : 0; " + reg(x) + " -= " + reg(y) + ";";
+            case 0x7: return "c.V[0xF] = " + reg(y) + " > " + reg(x) + " ? 1 : 0; " + reg(x) + " = Byte(" + reg(y) + " - " + reg(x) + ");";
+            }
+            break;
+        case 0xF000:
+            switch (op & 0x00FF) {
+            case 0x07: return reg(x) + " = c.delayTimer;";
+            case 0x15: return "c.delayTimer = " + reg(x) + ";";
+            case 0x18: return "c.soundTimer = " + reg(x) + ";";
+            case 0x1E: return "c.I += " + reg(x) + ";";
+            }
+            break;
+        }
+        return "";
+    }
+
+    // bytes Fx33/Fx55 write at I
+    int writes(OpCode op)
+    {
+        return (op & 0x00FF) == 0x33 ? 3 : ((op & 0x0F00) >> 8) + 1;
+    }
+
+    std::string qualified(Dialect dialect)
+    {
+        switch (dialect) {
+        case Dialect::CosmacVip: return "Dialect::CosmacVip";
+        case Dialect::Chip48:    return "Dialect::Chip48";
+        case Dialect::SuperChip: return "Dialect::SuperChip";
+        case Dialect::Modern:    break;
+        }
+        return "Dialect::Modern";
+    }
+
+    void generate(std::ostream& out, std::string const& romName, Chip8 const& chip, std::size_t romSize, Dialect dialect)
+    {
+        const ControlFlow cfg = analyze(chip.memory);
+        const std::string dialectName = qualified(dialect);
+
+        auto opAt = [&](Word address) { return OpCode(chip.memory[address] << 8 | chip.memory[address + 1]); };
+
+        std::size_t instructions = 0;
+        for (auto const& b : cfg.blocks) {
+            instructions += b.second.size();
+        }
+
+        out << "// Generated by chip8-aot from " << romName << ", do not edit.\n";
+        out << "// " << cfg.blocks.size() << " blocks, " << instructions << " instructions"
+            << (cfg.indirect ? ", has indirect jumps (Bnnn)" : "") << ".\n\n";
+        out << "#include \"AotProgram.h\"\n\n";
+
+        // an empty array isn't allowed, an empty rom gets a dummy byte
+        out << "const Byte aotRom[] = {";
+        for (std::size_t n = 0; n < std::max<std::size_t>(romSize, 1); ++n) {
+            out << (n % 16 ? " " : "\n    ") << hex(chip.memory[Chip8::StartAddress + n], 2) << ',';
+        }
+        out << "\n};\n";
+        out << "const std::size_t aotRomSize = " << romSize << ";\n";
+        out << "const Dialect aotDialect = " << dialectName << ";\n\n";
+
+        out << "namespace {\n\n";
+
+        // decoded instructions for everything that calls a handler
+        for (auto const& b : cfg.blocks) {
+            for (Word pc = b.second.start; pc < b.second.end; pc += 2) {
+                if (inlined(opAt(pc), pc).empty()) {
+                    out << "    const Instruction i" << name(pc) << " = decode(" << hex(opAt(pc), 4) << ", " << dialectName << ");\n";
+                }
+            }
+        }
+        out << '\n';
+
+        for (auto const& b : cfg.blocks) {
+            auto const& block = b.second;
+            const OpCode last = opAt(block.end - 2);
+            const bool writer = flow(last) == Flow::Write;
+
+            out << "    // " << hex(block.start, 3) << " - " << hex(block.end - 2, 3) << '\n';
+            out << "    " << (writer ? "bool" : "void") << " b" << name(block.start) << "(Chip8& c)\n";
+            out << "    {\n";
+
+            for (Word pc = block.start; pc < block.end; pc += 2) {
+                const OpCode op = opAt(pc);
+                const std::string code = inlined(op, pc);
+
+                out << "        ";
+                if (!code.empty()) {
+                    out << code;
+                }
+                else if (flow(op) == Flow::Write) {
+                    out << "const Word target = c.I; i" << name(pc) << ".execute(c, i" << name(pc) << ");";
+                }
+                else {
+                    if (usesPC(op)) {
+                        out << "c.PC = " << hex(pc + 2, 3) << "; ";
+                    }
+                    out << 'i' << name(pc) << ".execute(c, i" << name(pc) << ");";
+                }
+                out << " // " << hex(op, 4).substr(2) << '\n';
+            }
+
+            const Flow f = flow(last);
+            if (f == Flow::Next || f == Flow::Write) {
+                out << "        c.PC = " << hex(block.end, 3) << ";\n";
+            }
+            if (writer) {
+                out << "        return aotWritesCode(target, " << writes(last) << ");\n";
+            }
+            out << "    }\n\n";
+        }
+
+        out << "}\n\n";
+
+        // the code map for the write checks of the blocks and the runner, one bit per address
+        out << "namespace {\n\n";
+        out << "    const uint64_t Code[64] = {";
+        for (int word = 0; word < 64; ++word) {
+            uint64_t bits = 0;
+            for (int bit = 0; bit < 64; ++bit) {
+                bits |= uint64_t(cfg.code.test(word * 64 + bit)) << bit;
+            }
+            std::ostringstream s;
+            s << "0x" << std::hex << std::setfill('0') << std::setw(16) << bits;
+            out << (word % 4 ? " " : "\n        ") << s.str() << ',';
+        }
+        out << "\n    };\n\n";
+        out << "}\n\n";
+        out << "bool aotWritesCode(Word address, int length)\n";
+        out << "{\n";
+        out << "    for (int a = address; a < address + length; ++a) {\n";
+        out << "        if (Code[(a & 0x0FFF) >> 6] >> (a & 63) & 1) {\n";
+        out << "            return true;\n";
+        out << "        }\n";
+        out << "    }\n";
+        out << "    return false;\n";
+        out << "}\n\n";
+
+        out << "std::size_t aotBlock(Chip8& c, std::size_t steps, bool& modified)\n";
+        out << "{\n";
+        out << "    switch (c.PC) {\n";
+        for (auto const& b : cfg.blocks) {
+            auto const& block = b.second;
+            const bool writer = flow(opAt(block.end - 2)) == Flow::Write;
+
+            out << "    case " << hex(block.start, 3) << ": ";
+            if (block.size() > 1) {
+                out << "if (steps < " << block.size() << ") { return 0; } ";
+            }
+            out << (writer ? "modified = b" : "b") << name(block.start) << "(c); return " << block.size() << ";\n";
+        }
+        out << "    }\n";
+        out << "    (void)steps;\n";
+        out << "    (void)modified;\n";
+        out << "    return 0;\n";
+        out << "}\n";
+    }
+
+}
+
+int main(int argc, char** argv)
+{
+    Dialect dialect = Dialect::Modern;
+    std::string romPath;
+    std::string outPath;
+
+    for (int n = 1; n < argc; ++n) {
+        const std::string arg = argv[n];
+        if (arg == "--dialect" && n + 1 < argc) {
+            if (!parseDialect(argv[++n], dialect)) { usage(); return EXIT_FAILURE; }
+        }
+        else if (arg == "-o" && n + 1 < argc) { outPath = argv[++n]; }
+        else if (arg.rfind("-", 0) == 0)      { usage(); return EXIT_FAILURE; }
+        else if (romPath.empty())             { romPath = arg; }
+        else                                  { usage(); return EXIT_FAILURE; }
+    }
+
+    if (romPath.empty()) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    std::ifstream file(romPath, std::ios::binary);
+    if (!file) {
+        std::cout << "Can't read rom " << romPath << '\n';
+        return EXIT_FAILURE;
+    }
+    const std::vector<Byte> rom((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    Chip8 chip;
+    if (!chip.load(rom.data(), rom.size())) {
+        std::cout << "Rom " << romPath << " doesn't fit into memory\n";
+        return EXIT_FAILURE;
+    }
+
+    if (outPath.empty()) {
+        generate(std::cout, romPath, chip, rom.size(), dialect);
+        return EXIT_SUCCESS;
+    }
+
+    std::ofstream out(outPath);
+    generate(out, romPath, chip, rom.size(), dialect);
+    return out ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "Chip8.h"
+
+// Interface of the C++ source chip8-aot generates for a rom (see Aot.cpp). The generated
+// translation unit defines these, AotRunner.cpp links against them.
+
+extern const Byte        aotRom[];
+extern const std::size_t aotRomSize;
+extern const Dialect     aotDialect;
+
+// Executes the translated block that starts at PC, if there is one with at most 'steps' instructions.
+// Returns the number of executed instructions, 0 == no block, the caller has to interpret.
+// 'modified' is set when the block wrote into translated code, the translation can't be used anymore.
+std::size_t aotBlock(Chip8& c, std::size_t steps, bool& modified);
+
+// True if [address, address + length) overlaps translated code. The runner checks the Fx33/Fx55
+// it interprets with this, the blocks check their own.
+bool aotWritesCode(Word address, int length);
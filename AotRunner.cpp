@@ -0,0 +1,135 @@
+// Standalone runner for a rom translated by chip8-aot, no SDL involved.
+// Built from AotRunner.cpp and the generated source, see "make aot" in the Makefile.
+//
+//   chip8-aot-runner [options]
+//
+//   --frames N     frames to run (default 600)
+//   --ipf N        instructions per 60 Hz frame (default 10)
+//   --check        run the same frames on DecodeCache as well and compare the final states
+//   --screen       print the final screen
+//
+// Prints the executed instructions, the state hash (the same as chip8-batch) and the throughput.
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "AotProgram.h"
+#include "DecodeCache.h"
+#include "Hash.h"
+#include "Scheduler.h"
+
+
+namespace {
+
+    // the translated blocks, with the interpreter for everything in between
+    class AotEngine {
+    public:
+        explicit AotEngine(Chip8& chip) : chip(chip) {}
+
+        void run(std::size_t steps)
+        {
+            while (steps > 0) {
+                if (!modified) {
+                    const std::size_t executed = aotBlock(chip, steps, modified);
+                    if (executed > 0) {
+                        steps -= executed;
+                        continue;
+                    }
+                }
+
+                // not DecodeCache, it wouldn't notice the writes of the translated blocks;
+                // an interpreted Fx33/Fx55 can overwrite translated code as well
+                const Instruction in = decode(chip.currentOp(), aotDialect);
+                const Word target = chip.I;
+                chip.execute(in);
+                if (in.writes && aotWritesCode(target, in.writes)) {
+                    modified = true;
+                }
+                steps--;
+            }
+        }
+
+        bool translationValid() const { return !modified; }
+
+    private:
+        Chip8& chip;
+        bool   modified = false;
+    };
+
+    void printScreen(Rows<32> const& screen)
+    {
+        for (auto row : screen) {
+            for (int x = 0; x < Chip8::ScreenWidth; ++x) {
+                std::cout << ((row >> (63 - x)) & 1 ? '#' : '.');
+            }
+            std::cout << '\n';
+        }
+    }
+
+    void usage()
+    {
+        std::cout << "usage: chip8-aot-runner [--frames N] [--ipf N] [--check] [--screen]\n";
+    }
+
+}
+
+int main(int argc, char** argv)
+{
+    uint64_t frames  = 600;
+    unsigned ipf     = 10;
+    bool     check   = false;
+    bool     screens = false;
+
+    for (int n = 1; n < argc; ++n) {
+        const std::string arg = argv[n];
+        const bool hasValue = n + 1 < argc;
+
+        if (arg == "--frames" && hasValue)   { frames = std::strtoull(argv[++n], nullptr, 10); }
+        else if (arg == "--ipf" && hasValue) { ipf = unsigned(std::strtoul(argv[++n], nullptr, 10)); }
+        else if (arg == "--check")           { check = true; }
+        else if (arg == "--screen")          { screens = true; }
+        else                                 { usage(); return EXIT_FAILURE; }
+    }
+
+    Chip8 chip;
+    chip.load(aotRom, aotRomSize);
+
+    AotEngine engine(chip);
+    Scheduler<AotEngine> scheduler(chip, engine, ipf);
+    scheduler.setPacing(Pacing::Turbo);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (uint64_t f = 0; f < frames; ++f) {
+        scheduler.runFrame();
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << scheduler.cycles() << " instructions, hash " << std::hex << std::setfill('0') << std::setw(16) << hash(chip)
+              << std::dec << ", " << (seconds > 0 ? scheduler.cycles() / seconds / 1e6 : 0) << " MIPS"
+              << (engine.translationValid() ? "" : ", code was overwritten - interpreted from there on") << '\n';
+    if (screens) {
+        printScreen(chip.screen);
+    }
+
+    if (check) {
+        Chip8 reference;
+        reference.load(aotRom, aotRomSize);
+
+        DecodeCache interpreter(reference, aotDialect);
+        Scheduler<DecodeCache> referenceScheduler(reference, interpreter, ipf);
+        referenceScheduler.setPacing(Pacing::Turbo);
+        for (uint64_t f = 0; f < frames; ++f) {
+            referenceScheduler.runFrame();
+        }
+
+        if (hash(reference) != hash(chip)) {
+            std::cout << "mismatch, interpreter:\n" << reference << "translated:\n" << chip;
+            return EXIT_FAILURE;
+        }
+        std::cout << "same state as the interpreter\n";
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,142 @@
+// Headless check of the audio pipeline: runs a rom in real time and plays its sound through SDL.
+//
+//   chip8-audio [options] rom
+//
+//   --seconds N    how long (default 10)
+//   --ipf N        instructions per 60 Hz frame (default 10)
+//   --latency MS   samples kept in the ring (default 5)
+//   --buffer N     samples per audio callback (default 128)
+//
+// The SDL audio driver is SDL_AUDIODRIVER, dummy if it isn't set - disk writes the samples to a file.
+// Prints the underruns and the worst latency (ring + device buffer) seen after every pump.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DecodeCache.h"
+#include "Extended.h"
+#include "Scheduler.h"
+#include "SdlAudio.h"
+
+#if __has_include("sdl2/SDL.h")
+#include "sdl2/SDL.h"
+#else
+#include <SDL.h>
+#endif
+#undef main
+
+
+namespace {
+
+    void usage()
+    {
+        std::cout << "usage: chip8-audio [--seconds N] [--ipf N] [--latency MS] [--buffer N] rom\n";
+    }
+
+}
+
+int main(int argc, char** argv)
+{
+    double      seconds = 10;
+    unsigned    ipf     = 10;
+    double      latency = 5;
+    int         buffer  = 128;
+    std::string romPath;
+
+    for (int n = 1; n < argc; ++n) {
+        const std::string arg = argv[n];
+        const bool hasValue = n + 1 < argc;
+
+        if (arg == "--seconds" && hasValue)      { seconds = std::strtod(argv[++n], nullptr); }
+        else if (arg == "--ipf" && hasValue)     { ipf = unsigned(std::strtoul(argv[++n], nullptr, 10)); }
+        else if (arg == "--latency" && hasValue) { latency = std::strtod(argv[++n], nullptr); }
+        else if (arg == "--buffer" && hasValue)  { buffer = std::atoi(argv[++n]); }
+        else if (arg.rfind("-", 0) == 0)         { usage(); return EXIT_FAILURE; }
+        else                                     { romPath = arg; }
+    }
+
+    std::ifstream file(romPath, std::ios::binary);
+    if (romPath.empty() || !file || ipf == 0 || buffer <= 0) {
+        usage();
+        return EXIT_FAILURE;
+    }
+    const std::vector<Byte> rom((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    // the machine: Chip8 or ExtendedChip8, whatever the rom needs
+    Chip8 chip;
+    DecodeCache engine(chip);
+    Scheduler<DecodeCache> scheduler(chip, engine, ipf);
+
+    Extension extension = Extension::SuperChip;
+    const bool extended = needsExtended(rom.data(), rom.size(), extension);
+    auto big = std::make_unique<ExtendedChip8>(extension);
+    uint64_t bigCycles = 0;
+
+    if (!(extended ? big->load(rom.data(), rom.size()) : chip.load(rom.data(), rom.size()))) {
+        std::cout << "Rom " << romPath << " doesn't fit into memory\n";
+        return EXIT_FAILURE;
+    }
+
+    SDL_setenv("SDL_AUDIODRIVER", "dummy", 0);
+    if (SDL_Init(SDL_INIT_AUDIO) < 0) {
+        std::cout << "SDL: Init audio ; error ==" << SDL_GetError() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    AudioStream stream(48000, latency / 1000.0);
+    SdlAudio audio(stream, buffer);
+    if (!audio.open()) {
+        SDL_Quit();
+        return EXIT_FAILURE;
+    }
+
+    std::size_t worst = 0;
+    uint64_t pumps = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (;;) {
+        const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (elapsed >= seconds) {
+            break;
+        }
+
+        // catch up with the wall clock, then hand the sound state over
+        const uint64_t due = uint64_t(elapsed * Scheduler<DecodeCache>::FrameRate * ipf);
+        if (extended) {
+            for (; bigCycles < due; ++bigCycles) {
+                big->step();
+                if ((bigCycles + 1) % ipf == 0) {
+                    big->updateTimer();
+                }
+            }
+            stream.set(sound(*big));
+        }
+        else {
+            scheduler.runCycles(due - std::min(due, scheduler.cycles()));
+            stream.set(sound(chip));
+        }
+
+        stream.pump();
+        worst = std::max(worst, stream.queued());
+        pumps++;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    const double deviceMs = audio.deviceLatency() * 1000.0;
+    audio.close();
+    SDL_Quit();
+
+    std::cout << "driver " << (SDL_getenv("SDL_AUDIODRIVER") ? SDL_getenv("SDL_AUDIODRIVER") : "?")
+              << ", " << pumps << " pumps, " << stream.underruns() << " underruns, latency <= "
+              << (worst * 1000.0 / stream.rate() + deviceMs) << " ms (ring " << worst * 1000.0 / stream.rate()
+              << " ms + device " << deviceMs << " ms)\n";
+    return stream.underruns() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
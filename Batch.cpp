@@ -0,0 +1,221 @@
+// Headless batch runner, no SDL involved.
+//
+//   chip8-batch [options] rom[:inputscript] ...
+//
+//   --dir DIR      also run every file in DIR
+//   --pack FILE    also run every rom in the pack FILE, see RomLibrary.h
+//   --index FILE   rom index (see RomLibrary.h), created or updated if a rom wasn't in it yet
+//   --write-pack F write all roms into the pack F instead of running them
+//   --capture DIR  write the screens of every instance to DIR/<rom>-<seed>.c8fs (see Capture.h, chip8-frames)
+//   --cycles N     instruction limit per instance (default 1000000)
+//   --frames N     frame limit per instance (default: none)
+//   --ipf N        instructions per 60 Hz frame (default 10)
+//   --threads N    worker threads (default: all cores)
+//   --repeat N     run every rom N times, with the seeds seed, seed+1, ...
+//   --seed N       seed of the first run (default 1)
+//   --engine E     interpreter | recompiler | differential (default interpreter)
+//   --dialect D    vip | chip48 | schip | modern, for all roms (default: from the database, else the index, else modern)
+//   --dialects F   dialect database, see Dialects.h
+//   --screen       also print the final screen of every instance
+//   --profile      also print the profile summary of every instance (CHIP8_PROFILE builds only)
+//
+// Prints one line per instance (name, seed, halt reason, cycles, state hash) and the total throughput.
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "BatchRunner.h"
+#include "Dialects.h"
+#include "RomLibrary.h"
+
+
+namespace {
+
+    void usage()
+    {
+        std::cout << "usage: chip8-batch [--cycles N] [--frames N] [--ipf N] [--threads N] [--repeat N] [--seed N] [--engine interpreter|recompiler|differential] [--dialect D] [--dialects F] [--dir DIR] [--pack FILE] [--index FILE] [--write-pack FILE] [--capture DIR] [--screen] [--profile] rom[:inputscript] ...\n";
+    }
+
+    void printScreen(Rows<32> const& screen)
+    {
+        for (auto row : screen) {
+            for (int x = 0; x < Chip8::ScreenWidth; ++x) {
+                std::cout << ((row >> (63 - x)) & 1 ? '#' : '.');
+            }
+            std::cout << '\n';
+        }
+    }
+
+}
+
+int main(int argc, char** argv)
+{
+    uint64_t cycles  = 1000000;
+    uint64_t frames  = 0;
+    unsigned ipf     = 10;
+    unsigned threads = std::thread::hardware_concurrency();
+    unsigned repeat  = 1;
+    uint32_t seed    = 1;
+    Engine   engine  = Engine::Interpreter;
+    bool     screens = false;
+
+    DialectDatabase dialects;
+    bool     forceDialect = false;
+    Dialect  dialect = Dialect::Modern;
+    bool     profile = false;
+
+    // the roms are mapped, not read: the jobs point into the library
+    RomLibrary library;
+    std::vector<std::string> scripts; // by rom, empty == no input
+    std::string indexPath;
+    std::string packPath;
+    std::string captureDirectory;
+
+    for (int n = 1; n < argc; ++n) {
+        const std::string arg = argv[n];
+        const bool hasValue = n + 1 < argc;
+
+        if (arg == "--cycles" && hasValue)       { cycles = std::strtoull(argv[++n], nullptr, 10); }
+        else if (arg == "--frames" && hasValue)  { frames = std::strtoull(argv[++n], nullptr, 10); }
+        else if (arg == "--ipf" && hasValue)     { ipf = unsigned(std::strtoul(argv[++n], nullptr, 10)); }
+        else if (arg == "--threads" && hasValue) { threads = unsigned(std::strtoul(argv[++n], nullptr, 10)); }
+        else if (arg == "--repeat" && hasValue)  { repeat = unsigned(std::strtoul(argv[++n], nullptr, 10)); }
+        else if (arg == "--seed" && hasValue)    { seed = uint32_t(std::strtoul(argv[++n], nullptr, 10)); }
+        else if (arg == "--engine" && hasValue)  {
+            const std::string name = argv[++n];
+            if (name == "interpreter")       { engine = Engine::Interpreter; }
+            else if (name == "recompiler")   { engine = Engine::Recompiler; }
+            else if (name == "differential") { engine = Engine::Differential; }
+            else                             { usage(); return EXIT_FAILURE; }
+        }
+        else if (arg == "--dialect" && hasValue) {
+            if (!parseDialect(argv[++n], dialect)) { usage(); return EXIT_FAILURE; }
+            forceDialect = true;
+        }
+        else if (arg == "--dialects" && hasValue) {
+            if (!dialects.load(argv[++n])) { std::cout << "Can't read dialect database " << argv[n] << '\n'; return EXIT_FAILURE; }
+        }
+        else if (arg == "--dir" && hasValue) {
+            if (!library.addDirectory(argv[++n])) { std::cout << "Can't read directory " << argv[n] << '\n'; return EXIT_FAILURE; }
+        }
+        else if (arg == "--pack" && hasValue) {
+            if (!library.addPack(argv[++n])) { std::cout << "Can't read pack " << argv[n] << '\n'; return EXIT_FAILURE; }
+        }
+        else if (arg == "--index" && hasValue)   { indexPath = argv[++n]; }
+        else if (arg == "--write-pack" && hasValue) { packPath = argv[++n]; }
+        else if (arg == "--capture" && hasValue) { captureDirectory = argv[++n]; }
+        else if (arg == "--screen")              { screens = true; }
+        else if (arg == "--profile")             { profile = true; }
+        else if (arg.rfind("--", 0) == 0)        { usage(); return EXIT_FAILURE; }
+        else {
+            const auto split = arg.find(':');
+            if (!library.addFile(arg.substr(0, split))) {
+                std::cout << "Can't read rom " << arg.substr(0, split) << '\n';
+                return EXIT_FAILURE;
+            }
+            scripts.resize(library.roms().size());
+            scripts.back() = split != std::string::npos ? arg.substr(split + 1) : std::string();
+        }
+    }
+    scripts.resize(library.roms().size());
+
+#if !CHIP8_PROFILE
+    if (profile) {
+        std::cout << "--profile needs a build with CHIP8_PROFILE=1\n";
+        return EXIT_FAILURE;
+    }
+#endif
+
+    if (library.roms().empty()) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    if (!packPath.empty()) {
+        if (!writePack(packPath, library.roms())) {
+            std::cout << "Can't write pack " << packPath << '\n';
+            return EXIT_FAILURE;
+        }
+        std::cout << library.roms().size() << " roms written to " << packPath << '\n';
+        return EXIT_SUCCESS;
+    }
+
+    // a missing or outdated index is no error, it's rebuilt
+    RomIndex index;
+    if (!indexPath.empty()) {
+        index.load(indexPath);
+    }
+
+    std::vector<Job> jobs;
+    for (std::size_t r = 0; r < library.roms().size(); ++r) {
+        auto const& rom = library.roms()[r];
+        auto const& meta = index.lookup(rom, &dialects);
+
+        Job job;
+        job.name = rom.name;
+        job.rom = rom;
+        job.cycles = cycles;
+        job.frames = frames;
+        job.instructionsPerFrame = ipf;
+        job.engine = engine;
+        job.analysed = true;
+        job.extended = meta.extended;
+        job.extension = meta.extension;
+
+        job.dialect = forceDialect ? dialect : meta.dialect;
+
+        if (!scripts[r].empty() && !loadInputScript(scripts[r], job.input)) {
+            std::cout << "Can't read input script " << scripts[r] << '\n';
+            return EXIT_FAILURE;
+        }
+
+        for (unsigned i = 0; i < repeat; ++i) {
+            job.seed = seed + i;
+            if (!captureDirectory.empty()) {
+                job.capture = (std::filesystem::path(captureDirectory) /
+                               (std::filesystem::path(rom.name).stem().string() + '-' + std::to_string(job.seed) + ".c8fs")).string();
+            }
+            jobs.push_back(job);
+        }
+    }
+
+    if (!indexPath.empty() && index.modified() && !index.save(indexPath)) {
+        std::cout << "Can't write index " << indexPath << '\n';
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto results = runBatch(jobs, threads);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint64_t total = 0;
+    for (std::size_t n = 0; n < results.size(); ++n) {
+        auto const& r = results[n];
+        total += r.cycles;
+
+        std::cout << r.name << ' ' << jobs[n].seed << ' ' << toString(r.halt) << ' ' << r.cycles << ' '
+                  << std::hex << std::setfill('0') << std::setw(16) << r.hash << std::dec << '\n';
+        if (r.captureFailed) {
+            std::cout << "Can't write frame stream " << jobs[n].capture << '\n';
+        }
+        if (r.diverged) {
+            std::cout << "The recompiler diverged from the interpreter\n";
+        }
+        if (screens) {
+            printScreen(r.screen);
+        }
+#if CHIP8_PROFILE
+        if (profile) {
+            r.profile.summary(std::cout);
+        }
+#endif
+    }
+
+    std::cout << results.size() << " instances, " << total << " instructions in " << seconds << " s, "
+              << (seconds > 0 ? total / seconds / 1e6 : 0) << " MIPS\n";
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,292 @@
+#include "BatchRunner.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+#include "Capture.h"
+#include "Extended.h"
+#include "Hash.h"
+#include "Scheduler.h"
+#include "ThreadPool.h"
+
+
+namespace {
+
+    // the engine runs this many instructions between two checks for input and halting
+    constexpr uint64_t Slice = 1024;
+
+    bool isSelfJump(Chip8 const& c)
+    {
+        const OpCode op = c.currentOp();
+        return (op & 0xF000) == 0x1000 && (op & 0x0FFF) == c.PC;
+    }
+
+    bool isKeyWait(Chip8 const& c)
+    {
+        const OpCode op = c.currentOp();
+        if ((op & 0xF0FF) != 0xF00A) {
+            return false;
+        }
+        return std::none_of(c.key.begin(), c.key.end(), [](Byte k) { return k == Pressed; });
+    }
+
+    // the same loop as in run() for ExtendedChip8, which has no Scheduler: one frame every ipf instructions
+    void runExtended(Job const& job, Extension extension, ThreadPool* encoders, Result& result)
+    {
+        result.extended = true;
+
+        auto chip = std::make_unique<ExtendedChip8>(extension, job.dialect);
+        chip->seed(job.seed);
+        if (!chip->load(job.rom.data, job.rom.size)) {
+            result.halt = Halt::RomSize;
+            return;
+        }
+
+        const uint64_t ipf = std::max(1u, job.instructionsPerFrame);
+        uint64_t limit = job.cycles;
+        if (job.frames > 0) {
+            limit = std::min(limit, job.frames * ipf);
+        }
+
+        auto capture = job.capture.empty() ? nullptr : std::make_unique<FrameEncoder>(encoders);
+        const bool capturing = capture && capture->open(job.capture);
+        result.captureFailed = capture && !capturing;
+
+        std::size_t event = 0;
+        uint64_t cycles = 0;
+
+        while (cycles < limit) {
+            for (; event < job.input.size() && job.input[event].cycle <= cycles; ++event) {
+                chip->key[job.input[event].key & 0xF] = job.input[event].pressed ? Pressed : 0;
+            }
+
+            const OpCode op = chip->currentOp();
+            if (chip->exited) {
+                result.halt = Halt::Exit;
+                break;
+            }
+            if (chip->unknown) {
+                result.halt = Halt::Unknown;
+                break;
+            }
+            if (chip->stackFault) {
+                result.halt = Halt::Stack;
+                break;
+            }
+            if ((op & 0xF000) == 0x1000 && (op & 0x0FFF) == chip->PC) {
+                result.halt = Halt::Loop;
+                break;
+            }
+            if (event == job.input.size() && (op & 0xF0FF) == 0xF00A &&
+                std::none_of(chip->key.begin(), chip->key.end(), [](Byte k) { return k == Pressed; })) {
+                result.halt = Halt::KeyWait;
+                break;
+            }
+
+            // up to the next frame, input event or the limit
+            auto slice = std::min(ipf - cycles % ipf, limit - cycles);
+            if (event < job.input.size()) {
+                slice = std::min(slice, job.input[event].cycle - cycles);
+            }
+
+            cycles += chip->run(slice);
+            if (cycles % ipf == 0) {
+                chip->updateTimer();
+                result.frames++;
+                if (capturing) {
+                    capture->add(result.frames, *chip);
+                }
+            }
+        }
+
+        if (capturing && !capture->close(result.frames)) {
+            result.captureFailed = true;
+        }
+
+        result.cycles = cycles;
+        result.hash = hash(*chip);
+        if (!chip->hires) {
+            for (int row = 0; row < ExtendedChip8::LoresHeight; ++row) {
+                result.screen[row] = chip->planes[0][row][0];
+            }
+        }
+    }
+
+}
+
+Result run(Job const& job, ThreadPool* encoders)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    Result result;
+    result.name = job.name;
+
+    // every way out has the host time
+    auto finished = [&]() -> Result& {
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return result;
+    };
+
+    Extension extension = job.extension;
+    const bool extended = job.analysed ? job.extended : needsExtended(job.rom.data, job.rom.size, extension);
+    if (extended) {
+        runExtended(job, extension, encoders, result);
+        return finished();
+    }
+
+    Chip8 chip;
+    chip.seed(job.seed);
+    if (!chip.load(job.rom.data, job.rom.size)) {
+        result.halt = Halt::RomSize;
+        return finished();
+    }
+
+    // an unknown opcode within a slice halts the engine on it, the next check stops the instance
+    Recompiler engine(chip, job.engine, job.dialect, OnUnknown::Halt);
+    Scheduler<Recompiler> scheduler(chip, engine, job.instructionsPerFrame);
+    scheduler.setPacing(Pacing::Turbo);
+#if CHIP8_PROFILE
+    engine.setProfile(&result.profile);
+    scheduler.setProfile(&result.profile);
+#endif
+
+    uint64_t limit = job.cycles;
+    if (job.frames > 0) {
+        limit = std::min(limit, job.frames * scheduler.cyclesPerFrame());
+    }
+
+    // a capture takes every frame at its boundary, within the slices
+    auto capture = job.capture.empty() ? nullptr : std::make_unique<FrameEncoder>(encoders);
+    const bool capturing = capture && capture->open(job.capture);
+    result.captureFailed = capture && !capturing;
+    if (capturing) {
+        scheduler.setFrameHook([&] { capture->add(scheduler.frames(), chip.screen); });
+    }
+
+    std::size_t event = 0;
+    uint64_t cycles = 0;
+
+    while (cycles < limit) {
+        for (; event < job.input.size() && job.input[event].cycle <= cycles; ++event) {
+            chip.key[job.input[event].key & 0xF] = job.input[event].pressed ? Pressed : 0;
+        }
+
+        // both states can't be left anymore, no need to burn the remaining cycles
+        if (isSelfJump(chip)) {
+            result.halt = Halt::Loop;
+            break;
+        }
+        if (event == job.input.size() && isKeyWait(chip)) {
+            result.halt = Halt::KeyWait;
+            break;
+        }
+        if (!known(decode(chip.currentOp(), job.dialect))) {
+            result.halt = Halt::Unknown;
+            break;
+        }
+        if (chip.stackFault()) {
+            result.halt = Halt::Stack;
+            break;
+        }
+
+        auto slice = std::min(Slice, limit - cycles);
+        if (event < job.input.size()) {
+            slice = std::min(slice, job.input[event].cycle - cycles);
+        }
+
+        scheduler.runCycles(slice);
+        cycles += slice;
+    }
+
+    // the limit may have been reached in the slice that halted on it
+    if (result.halt == Halt::Cycles && !known(decode(chip.currentOp(), job.dialect))) {
+        result.halt = Halt::Unknown;
+    }
+    if (result.halt == Halt::Cycles && chip.stackFault()) {
+        result.halt = Halt::Stack;
+    }
+
+    if (capturing && !capture->close(scheduler.frames())) {
+        result.captureFailed = true;
+    }
+
+    result.cycles = cycles;
+    result.frames = scheduler.frames();
+    result.diverged = engine.diverged();
+    result.hash = hash(chip);
+    result.screen = chip.screen;
+    return finished();
+}
+
+std::vector<Result> runBatch(std::vector<Job> const& jobs, unsigned threads)
+{
+    std::vector<Result> results(jobs.size());
+
+    // the encoders get the cores the workers leave free; without any a capture is encoded by the
+    // worker that emulates it, more threads would only take turns with the workers on the same cores
+    const std::size_t busy = std::min<std::size_t>(std::max(1u, threads), jobs.size());
+    const std::size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    std::unique_ptr<ThreadPool> encoders;
+    if (cores > busy && std::any_of(jobs.begin(), jobs.end(), [](Job const& job) { return !job.capture.empty(); })) {
+        encoders = std::make_unique<ThreadPool>(unsigned(cores - busy));
+    }
+
+    ThreadPool pool(threads);
+    for (std::size_t n = 0; n < jobs.size(); ++n) {
+        pool.submit([&jobs, &results, &encoders, n] { results[n] = run(jobs[n], encoders.get()); });
+    }
+    pool.wait();
+
+    return results;
+}
+
+bool loadInputScript(std::string const& path, std::vector<KeyEvent>& events)
+{
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+
+    std::vector<KeyEvent> parsed;
+    std::string line;
+    while (std::getline(file, line)) {
+        line = line.substr(0, line.find('#'));
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+
+        std::istringstream fields(line);
+        KeyEvent e;
+        int key = 0;
+        std::string state;
+        if (!(fields >> e.cycle >> std::hex >> key >> state) || key < 0 || key > 0xF || (state != "down" && state != "up")) {
+            return false;
+        }
+
+        e.key = Byte(key);
+        e.pressed = state == "down";
+        parsed.push_back(e);
+    }
+
+    std::stable_sort(parsed.begin(), parsed.end(), [](KeyEvent const& a, KeyEvent const& b) { return a.cycle < b.cycle; });
+    events = std::move(parsed);
+    return true;
+}
+
+const char* toString(Halt halt)
+{
+    switch (halt) {
+    case Halt::Cycles:  return "cycles";
+    case Halt::Loop:    return "loop";
+    case Halt::KeyWait: return "keywait";
+    case Halt::Exit:    return "exit";
+    case Halt::Unknown: return "unknown";
+    case Halt::Stack:   return "stack";
+    case Halt::RomSize: return "romsize";
+    }
+    return "?";
+}
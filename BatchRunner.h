@@ -0,0 +1,76 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Chip8.h"
+#include "Profile.h"
+#include "Recompiler.h"
+#include "RomLibrary.h"
+#include "ThreadPool.h"
+
+// Headless runs of many independent Chip8 instances, spread over all cores.
+
+// key 'key' goes down/up right before instruction number 'cycle' is executed
+struct KeyEvent {
+    uint64_t cycle   = 0;
+    Byte     key     = 0;
+    bool     pressed = false;
+};
+
+struct Job {
+    std::string           name;
+    Rom                   rom;                // points into a RomLibrary, which must outlive the run
+    std::vector<KeyEvent> input;              // sorted by cycle
+    uint64_t              cycles = 1000000;   // upper limit of executed instructions
+    uint64_t              frames = 0;         // upper limit of 60 Hz frames, 0 == no limit
+    unsigned              instructionsPerFrame = 10;
+    uint32_t              seed   = 1;         // for Cxnn
+    Engine                engine = Engine::Interpreter;
+    Dialect               dialect = Dialect::Modern;
+    bool                  analysed = false;   // 'extended' and 'extension' are known (RomIndex), run() doesn't analyse the rom
+    bool                  extended = false;
+    Extension             extension = Extension::SuperChip;
+    std::string           capture;            // frame stream of every frame (Capture.h) is written here, empty == none
+};
+
+enum class Halt {
+    Cycles,   // the cycle or frame limit was reached
+    Loop,     // 1nnn jumps to itself
+    KeyWait,  // Fx0A waits for a key, but the input script has no more events
+    Exit,     // 00FD (SUPER-CHIP)
+    Unknown,  // PC is on an opcode that doesn't exist, the instance stopped there instead of asserting
+              // (the Chip8 engines notice it between two slices, the rest of the slice is counted)
+    Stack,    // a 2nnn with a full stack or a 00EE with an empty one, the instance stopped there as for Unknown
+    RomSize   // the rom doesn't fit into memory, nothing was executed
+};
+
+struct Result {
+    std::string name;
+    Halt        halt    = Halt::Cycles;
+    uint64_t    cycles  = 0;     // executed instructions
+    uint64_t    frames  = 0;     // completed frames
+    uint64_t    hash    = 0;     // hash of the final state, see Hash.h
+    Rows<32>    screen  = {};    // the 64x32 screen; of a rom that ran on the extended machine only while it's in lo-res
+    bool        extended = false; // the rom needed ExtendedChip8
+    bool        captureFailed = false; // the frame stream couldn't be written
+    bool        diverged = false; // Engine::Differential found a block that behaves different than the interpreter
+    double      seconds = 0;     // host time of this job
+#if CHIP8_PROFILE
+    Profile     profile;
+#endif
+};
+
+// Runs a single job on the calling thread. Roms that need SUPER-CHIP or XO-CHIP run on ExtendedChip8
+// (interpreted, 'engine' is ignored), all others on the Chip8 engines.
+// A capture is encoded on 'encoders', null == on the calling thread, between the frames.
+Result run(Job const& job, ThreadPool* encoders = nullptr);
+
+// runs all jobs on 'threads' workers, results are in the order of 'jobs'
+std::vector<Result> runBatch(std::vector<Job> const& jobs, unsigned threads);
+
+// Input script: one event per line, "<cycle> <key as hex digit> down|up"; '#' starts a comment.
+// Returns false (and leaves 'events' untouched) if the file can't be read or a line is broken.
+bool loadInputScript(std::string const& path, std::vector<KeyEvent>& events);
+
+const char* toString(Halt halt);
@@ -0,0 +1,307 @@
+// Benchmarks of the engines on generated roms, no SDL involved.
+//
+//   chip8-bench [options]
+//
+//   --frames N     measured frames per rom and engine (default 2000)
+//   --ipf N        instructions per frame (default 1000)
+//   --lanes N      machines run by the lanes engine (default 64)
+//   --rom NAME     only this rom (alu, draw, call, memory, selfmod)
+//   --engine NAME  only this engine (emulate, interpreter, recompiler, differential, lanes)
+//   --verify       the lanes engine checks every lane against Chip8::emulate after every step (slow);
+//                  reported as "lanes-verify", a divergence fails the run
+//   --csv          csv instead of one json object per line
+//
+// Every line has the instructions per second, the host time per frame (average and percentiles)
+// and the hash of the final state - all engines have to end up with the same hash for a rom.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "DecodeCache.h"
+#include "Hash.h"
+#include "Lanes.h"
+#include "Recompiler.h"
+#include "Scheduler.h"
+
+
+namespace {
+
+    struct Rom {
+        std::string       name;
+        std::vector<Byte> code;
+    };
+
+    // a tiny assembler: opcodes are appended from StartAddress on, org() skips ahead with zeros
+    struct Assembler {
+        std::vector<Byte> code;
+
+        Word here() const { return Word(Chip8::StartAddress + code.size()); }
+
+        Assembler& operator << (OpCode op)
+        {
+            code.push_back(Byte(op >> 8));
+            code.push_back(Byte(op));
+            return *this;
+        }
+
+        void org(Word address)
+        {
+            code.resize(address - Chip8::StartAddress, 0);
+        }
+    };
+
+    // 8xyN, 7xnn and 6xnn only, one jump per loop
+    Rom alu()
+    {
+        Assembler a;
+        a << 0x6001 << 0x6102 << 0x6203 << 0x6304 << 0x6405;
+        const Word loop = a.here();
+        for (int n = 0; n < 4; ++n) {
+            a << 0x8014 << 0x8125 << 0x8231 << 0x8342 << 0x8403 << 0x8016 << 0x810E << 0x8417;
+            a << 0x7005 << 0x7107 << 0x8230 << 0x6303;
+        }
+        a << (0x1000 | loop);
+        return { "alu", a.code };
+    }
+
+    // font sprites all over the screen, half of them collide
+    Rom draw()
+    {
+        Assembler a;
+        a << 0x6000 << 0x6100;
+        const Word loop = a.here();
+        a << 0xF029 << 0xD015 << 0x7003 << 0x7105 << 0xD105 << 0x7007 << 0xF129 << 0xD01F;
+        a << (0x1000 | loop);
+        return { "draw", a.code };
+    }
+
+    // three levels of nested calls
+    Rom call()
+    {
+        Assembler a;
+        a << 0x2210 << 0x1200;
+        a.org(0x210);
+        a << 0x2220 << 0x2220 << 0x00EE;
+        a.org(0x220);
+        a << 0x2230 << 0x00EE;
+        a.org(0x230);
+        a << 0x7001 << 0x00EE;
+        return { "call", a.code };
+    }
+
+    // Fx55/Fx65 of all and of half the registers, outside of the code
+    Rom memory()
+    {
+        Assembler a;
+        const Word loop = a.here();
+        a << 0xA400 << 0xFF55 << 0xA400 << 0xFF65 << 0xA500 << 0xF755 << 0xA500 << 0xF765;
+        a << 0x7001 << 0x7101;
+        a << (0x1000 | loop);
+        return { "memory", a.code };
+    }
+
+    // Fx55 rewrites the constant of a 6xnn in the loop on every iteration
+    Rom selfmod()
+    {
+        Assembler a;
+        a << 0x606B;                // V0 = high byte of 6Bnn
+        const Word loop = a.here();
+        const Word target = loop + 10;
+        a << 0x7101;                // V1 += 1, the new constant
+        a << (0xA000 | target);
+        a << 0xF155;                // memory[target] = 6B, memory[target + 1] = V1
+        a << 0x8304 << 0x7301;
+        a << 0x6B00;                // target
+        a << 0x82B4;
+        a << (0x1000 | loop);
+        return { "selfmod", a.code };
+    }
+
+    // Chip8::emulate() as an engine, the baseline of everything else
+    struct Emulate {
+        explicit Emulate(Chip8& chip) : chip(chip) {}
+
+        Chip8& chip;
+
+        void run(std::size_t steps)
+        {
+            for (std::size_t n = 0; n < steps; ++n) {
+                chip.emulate(chip.currentOp());
+            }
+        }
+    };
+
+    // the recompiler checking every block against Chip8::emulate, what that check costs
+    struct Differential : Recompiler {
+        explicit Differential(Chip8& chip) : Recompiler(chip, Engine::Differential) {}
+    };
+
+    struct Measurement {
+        uint64_t              instructions = 0;
+        uint64_t              hash = 0;
+        std::vector<uint64_t> frames; // host nanoseconds of every frame
+    };
+
+    // calls 'frame' (which runs one frame) 'frames' times and times every call
+    void measure(std::size_t frames, std::function<void()> const& frame, Measurement& m)
+    {
+        m.frames.reserve(frames);
+        for (std::size_t n = 0; n < frames; ++n) {
+            const auto start = std::chrono::steady_clock::now();
+            frame();
+            const auto end = std::chrono::steady_clock::now();
+            m.frames.push_back(uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()));
+        }
+    }
+
+    // one machine, run by 'Engine' through a Scheduler
+    template <typename Engine>
+    Measurement single(Rom const& rom, std::size_t frames, unsigned ipf)
+    {
+        Chip8 chip;
+        chip.load(rom.code.data(), rom.code.size());
+        Engine engine(chip);
+
+        Scheduler<Engine> scheduler(chip, engine, ipf);
+        scheduler.setPacing(Pacing::Turbo);
+        scheduler.setIdleSkipping(false);
+
+        Measurement m;
+        measure(frames, [&] { scheduler.runFrame(); }, m);
+        m.instructions = scheduler.cycles();
+        m.hash = hash(chip);
+        return m;
+    }
+
+    Measurement lanes(Rom const& rom, std::size_t frames, unsigned ipf, std::size_t count, bool verify, bool& diverged)
+    {
+        Chip8 chip;
+        chip.load(rom.code.data(), rom.code.size());
+
+        Lanes l(count);
+        for (std::size_t n = 0; n < count; ++n) {
+            l.set(n, chip);
+        }
+        l.verify(verify);
+
+        Measurement m;
+        measure(frames, [&] { l.run(ipf); l.updateTimers(); }, m);
+        m.instructions = uint64_t(frames) * ipf * count;
+        m.hash = hash(l.get(0));
+        diverged = l.diverged();
+        return m;
+    }
+
+    uint64_t percentile(std::vector<uint64_t> const& sorted, double p)
+    {
+        if (sorted.empty()) {
+            return 0;
+        }
+        return sorted[std::min(sorted.size() - 1, std::size_t(p * (sorted.size() - 1) + 0.5))];
+    }
+
+    void report(Rom const& rom, std::string const& engine, Measurement m, bool csv)
+    {
+        std::sort(m.frames.begin(), m.frames.end());
+        uint64_t total = 0;
+        for (auto ns : m.frames) {
+            total += ns;
+        }
+
+        const double seconds = total / 1e9;
+        const double ips = seconds > 0 ? m.instructions / seconds : 0;
+        const double perFrame = m.frames.empty() ? 0 : double(total) / m.frames.size();
+
+        std::cout << std::fixed << std::setprecision(0);
+        if (csv) {
+            std::cout << rom.name << ',' << engine << ',' << m.instructions << ',' << ips << ',' << perFrame << ','
+                      << percentile(m.frames, 0.5) << ',' << percentile(m.frames, 0.9) << ',' << percentile(m.frames, 0.99) << ','
+                      << m.frames.back() << ',' << std::hex << std::setfill('0') << std::setw(16) << m.hash << std::dec << '\n';
+        }
+        else {
+            std::cout << "{\"rom\": \"" << rom.name << "\", \"engine\": \"" << engine << "\", \"instructions\": " << m.instructions
+                      << ", \"ips\": " << ips << ", \"nsPerFrame\": " << perFrame
+                      << ", \"p50\": " << percentile(m.frames, 0.5) << ", \"p90\": " << percentile(m.frames, 0.9)
+                      << ", \"p99\": " << percentile(m.frames, 0.99) << ", \"max\": " << m.frames.back()
+                      << ", \"hash\": \"" << std::hex << std::setfill('0') << std::setw(16) << m.hash << std::dec << "\"}\n";
+        }
+        std::cout << std::defaultfloat << std::setfill(' ');
+    }
+
+    void usage()
+    {
+        std::cout << "usage: chip8-bench [--frames N] [--ipf N] [--lanes N] [--rom NAME] [--engine NAME] [--verify] [--csv]\n";
+    }
+
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t frames = 2000;
+    unsigned    ipf    = 1000;
+    std::size_t count  = 64;
+    std::string onlyRom;
+    std::string onlyEngine;
+    bool        verify = false;
+    bool        csv    = false;
+
+    for (int n = 1; n < argc; ++n) {
+        const std::string arg = argv[n];
+        const bool hasValue = n + 1 < argc;
+
+        if (arg == "--frames" && hasValue)      { frames = std::strtoull(argv[++n], nullptr, 10); }
+        else if (arg == "--ipf" && hasValue)    { ipf = unsigned(std::strtoul(argv[++n], nullptr, 10)); }
+        else if (arg == "--lanes" && hasValue)  { count = std::strtoull(argv[++n], nullptr, 10); }
+        else if (arg == "--rom" && hasValue)    { onlyRom = argv[++n]; }
+        else if (arg == "--engine" && hasValue) { onlyEngine = argv[++n]; }
+        else if (arg == "--verify")             { verify = true; }
+        else if (arg == "--csv")                { csv = true; }
+        else                                    { usage(); return EXIT_FAILURE; }
+    }
+
+    if (frames == 0 || ipf == 0 || count == 0) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    if (csv) {
+        std::cout << "rom,engine,instructions,ips,nsPerFrame,p50,p90,p99,max,hash\n";
+    }
+
+    bool failed = false;
+    const Rom roms[] = { alu(), draw(), call(), memory(), selfmod() };
+    for (auto const& rom : roms) {
+        if (!onlyRom.empty() && rom.name != onlyRom) {
+            continue;
+        }
+        const auto wanted = [&](const char* engine) { return onlyEngine.empty() || onlyEngine == engine; };
+
+        if (wanted("emulate")) {
+            report(rom, "emulate", single<Emulate>(rom, frames, ipf), csv);
+        }
+        if (wanted("interpreter")) {
+            report(rom, "interpreter", single<DecodeCache>(rom, frames, ipf), csv);
+        }
+        if (wanted("recompiler") && CHIP8_RECOMPILER) {
+            report(rom, "recompiler", single<Recompiler>(rom, frames, ipf), csv);
+        }
+        if (wanted("differential") && CHIP8_RECOMPILER) {
+            report(rom, "differential", single<Differential>(rom, frames, ipf), csv);
+        }
+        if (wanted("lanes")) {
+            bool diverged = false;
+            report(rom, verify ? "lanes-verify" : "lanes", lanes(rom, frames, ipf, count, verify, diverged), csv);
+            if (diverged) {
+                std::cout << "Lanes diverged from Chip8::emulate on " << rom.name << '\n';
+                failed = true;
+            }
+        }
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,380 @@
+#include "Capture.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+
+namespace {
+
+    const char StreamMagic[4] = { 'C', '8', 'F', 'S' };
+    constexpr std::size_t HeaderSize = 12;
+    constexpr std::size_t FlushSize = 1 << 16;
+
+    // a hi-res screen, and its worst case record: 2 varints of up to 2 bytes and a literal for every 2 bytes
+    constexpr std::size_t MaxScreenBytes = 2 * ExtendedChip8::HiresHeight * ExtendedChip8::HiresWidth / 8;
+    constexpr std::size_t MaxScreenWords = MaxScreenBytes / 8;
+    constexpr std::size_t MaxRecordSize = 16 + 3 * MaxScreenBytes;
+
+    Byte* putVarint(Byte* o, uint64_t value)
+    {
+        while (value >= 0x80) {
+            *o++ = Byte(value | 0x80);
+            value >>= 7;
+        }
+        *o++ = Byte(value);
+        return o;
+    }
+
+    // the literals from counted + 1 on end at 'o', their count goes to 'counted'; returns the new end
+    Byte* endLiterals(Byte* counted, Byte* o)
+    {
+        const std::size_t count = std::size_t(o - counted - 1);
+        if (count >= 0x80) {
+            std::memmove(counted + 2, counted + 1, count); // the rare second byte of the count
+            o++;
+        }
+        putVarint(counted, count);
+        return o;
+    }
+
+    // byte 'b' of a packed row, MSB == leftmost pixel
+    Byte rowByte(WideRow const& row, int b)
+    {
+        return Byte(row[b >> 3] >> (56 - 8 * (b & 7)));
+    }
+
+    void setRowByte(WideRow& row, int b, Byte value)
+    {
+        const int shift = 56 - 8 * (b & 7);
+        row[b >> 3] = (row[b >> 3] & ~(uint64_t(0xFF) << shift)) | uint64_t(value) << shift;
+    }
+
+}
+
+FrameEncoder::FrameEncoder(ThreadPool* encoders, std::size_t batchWords)
+    : encoders(encoders)
+    , batchWords(std::max<std::size_t>(batchWords, MaxScreenWords))
+    , halfRecords(this->batchWords / Chip8::ScreenHeight)
+{
+}
+
+FrameEncoder::~FrameEncoder()
+{
+    if (isOpen) {
+        close(latest);
+    }
+}
+
+bool FrameEncoder::open(std::string const& path)
+{
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        return false;
+    }
+
+    ring.resize(2 * batchWords);
+    records.resize(2 * halfRecords);
+
+    // a record always fits behind less than FlushSize bytes, written through a pointer
+    out.resize(FlushSize + MaxRecordSize);
+    std::memcpy(out.data(), StreamMagic, sizeof(StreamMagic));
+    outSize = sizeof(StreamMagic);
+    for (uint32_t word : { FrameStreamVersion, 0u }) {
+        for (int n = 0; n < 4; ++n) {
+            out[outSize++] = Byte(word >> (8 * n));
+        }
+    }
+
+    isOpen = true;
+    return true;
+}
+
+void FrameEncoder::add(uint64_t number, Rows<32> const& screen)
+{
+    // most frames look like the previous one, they cost the comparison and nothing else
+    latest = number;
+    if (lastWords && last.mode == 0 && last.used == Chip8::ScreenHeight &&
+        std::memcmp(screen.data(), lastWords, sizeof(screen)) == 0) {
+        return;
+    }
+    std::memcpy(claim(number, 0, Chip8::ScreenHeight), screen.data(), sizeof(screen));
+}
+
+void FrameEncoder::add(uint64_t number, ExtendedChip8 const& chip)
+{
+    latest = number;
+    const Byte mode = chip.hires ? 1 : 0;
+    const int words = chip.hires ? 2 : 1; // hi-res rows are whole WideRows, lo-res rows only their first word
+
+    bool same = lastWords && last.mode == mode;
+    uint64_t const* word = lastWords;
+    for (auto const& plane : chip.planes) {
+        for (int row = 0; row < chip.height() && same; ++row) {
+            same = std::equal(plane[row].begin(), plane[row].begin() + words, word);
+            word += words;
+        }
+    }
+    if (same) {
+        return;
+    }
+
+    uint64_t* to = claim(number, mode, mode == 0 ? 2 * Chip8::ScreenHeight : 4 * ExtendedChip8::HiresHeight);
+    for (auto const& plane : chip.planes) {
+        for (int row = 0; row < chip.height(); ++row) {
+            to = std::copy_n(plane[row].begin(), words, to);
+        }
+    }
+}
+
+uint64_t* FrameEncoder::claim(uint64_t number, Byte mode, int used)
+{
+    if (filled + std::size_t(used) > batchWords || count == halfRecords) {
+        hand();
+    }
+
+    Record& record = records[std::size_t(half) * halfRecords + count++];
+    record.number = number;
+    record.mode = mode;
+    record.used = used;
+    last = record;
+
+    uint64_t* words = ring.data() + std::size_t(half) * batchWords + filled;
+    filled += std::size_t(used);
+    lastWords = words;
+    return words;
+}
+
+void FrameEncoder::hand()
+{
+    stallCount += finish() ? 1 : 0;
+
+    // the other half is free now, this one is encoded while it fills
+    const std::size_t from = std::size_t(half);
+    const std::size_t screens = count;
+    half ^= 1;
+    filled = 0;
+    count = 0;
+
+    auto encode = [this, from, screens] {
+        uint64_t const* words = ring.data() + from * batchWords;
+        for (std::size_t n = 0; n < screens; ++n) {
+            auto const& screen = records[from * halfRecords + n];
+            write(screen, words);
+            words += screen.used;
+        }
+    };
+    if (!encoders) {
+        encode();
+        return;
+    }
+
+    encoding = true;
+    encoders->submit([this, encode] {
+        encode();
+
+        // notified under the lock, close() may destroy the encoder right after
+        std::lock_guard<std::mutex> lock(mutex);
+        encoding = false;
+        done.notify_one();
+    });
+}
+
+bool FrameEncoder::finish()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    const bool waits = encoding;
+    done.wait(lock, [this] { return !encoding; });
+    return waits;
+}
+
+bool FrameEncoder::close(uint64_t frames)
+{
+    if (!isOpen) {
+        return false;
+    }
+    isOpen = false;
+    if (count > 0) {
+        hand();
+    }
+    finish();
+
+    Byte* o = putVarint(out.data() + outSize, 0);
+    o = putVarint(o, frames);
+    outSize = std::size_t(o - out.data());
+    file.write(reinterpret_cast<char const*>(out.data()), std::streamsize(outSize));
+    byteCount += outSize;
+    outSize = 0;
+
+    const bool ok = bool(file);
+    file.close();
+    return ok;
+}
+
+void FrameEncoder::write(Record const& screen, uint64_t const* words)
+{
+    // after a size change there's nothing to compare with
+    if (screen.mode != previous.mode) {
+        previousWords = {};
+        previous.mode = screen.mode;
+    }
+
+    Byte* o = putVarint(out.data() + outSize, screen.number - previous.number);
+    *o++ = screen.mode;
+
+    // the XOR with the previous screen, which becomes this one
+    uint64_t changes[MaxScreenWords];
+    const int size = screen.size();
+    for (int n = 0; n < screen.used; ++n) {
+        changes[n] = words[n] ^ previousWords[std::size_t(n)];
+        previousWords[std::size_t(n)] = words[n];
+    }
+    for (int n = screen.used; n < size; ++n) {
+        changes[n] = previousWords[std::size_t(n)];
+        previousWords[std::size_t(n)] = 0;
+    }
+
+    // Zero bytes of the XOR are runs, everything else literals; the screen is mostly zero words,
+    // they are skipped four at a time. The literals go straight to the output behind one byte for
+    // their count (null == no literals being written).
+    std::size_t zeros = 0;
+    Byte* counted = nullptr;
+    for (int n = 0; n < size; ++n) {
+        const int from = n;
+        while (n + 4 <= size && (changes[n] | changes[n + 1] | changes[n + 2] | changes[n + 3]) == 0) {
+            n += 4;
+        }
+        while (n < size && changes[n] == 0) {
+            ++n;
+        }
+        if (n > from) {
+            if (counted) {
+                o = endLiterals(counted, o);
+                counted = nullptr;
+            }
+            zeros += 8 * std::size_t(n - from);
+            if (n == size) {
+                break;
+            }
+        }
+
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            const Byte b = Byte(changes[n] >> shift);
+            if (b == 0) {
+                if (counted) {
+                    o = endLiterals(counted, o);
+                    counted = nullptr;
+                }
+                zeros++;
+                continue;
+            }
+            if (!counted) {
+                o = putVarint(o, zeros);
+                zeros = 0;
+                counted = o++;
+            }
+            *o++ = b;
+        }
+    }
+    if (counted) {
+        o = endLiterals(counted, o);
+    }
+    else if (zeros > 0) {
+        o = putVarint(o, zeros);
+        *o++ = 0;
+    }
+    previous.number = screen.number;
+    outSize = std::size_t(o - out.data());
+
+    if (outSize >= FlushSize) {
+        file.write(reinterpret_cast<char const*>(out.data()), std::streamsize(outSize));
+        byteCount += outSize;
+        outSize = 0;
+    }
+}
+
+bool FrameDecoder::open(std::string const& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+    if (data.size() < HeaderSize || std::memcmp(data.data(), StreamMagic, sizeof(StreamMagic)) != 0 ||
+        (data[4] | data[5] << 8 | data[6] << 16 | uint32_t(data[7]) << 24) != FrameStreamVersion) {
+        return false;
+    }
+    at = HeaderSize;
+    current = Frame{};
+    current.number = 0;
+    broken = false;
+    frameCount = 0;
+    return true;
+}
+
+bool FrameDecoder::varint(uint64_t& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (at >= data.size()) {
+            return false;
+        }
+        const Byte b = data[at++];
+        value |= uint64_t(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool FrameDecoder::next(Frame& frame)
+{
+    uint64_t delta = 0;
+    if (!varint(delta)) {
+        broken = true;
+        return false;
+    }
+    if (delta == 0) {
+        broken = !varint(frameCount);
+        return false;
+    }
+    if (at >= data.size() || data[at] > 1) {
+        broken = true;
+        return false;
+    }
+
+    const int width = data[at] == 0 ? Chip8::ScreenWidth : ExtendedChip8::HiresWidth;
+    const int height = data[at] == 0 ? Chip8::ScreenHeight : ExtendedChip8::HiresHeight;
+    at++;
+    const uint64_t number = current.number + delta;
+    if (width != current.width || height != current.height) {
+        current = Frame{};
+        current.width = width;
+        current.height = height;
+    }
+    current.number = number;
+
+    const int bytes = width / 8;
+    const std::size_t total = std::size_t(2 * height * bytes);
+    for (std::size_t n = 0; n < total; ) {
+        uint64_t zeros = 0;
+        uint64_t literals = 0;
+        if (!varint(zeros) || !varint(literals) || zeros + literals == 0 || zeros + literals > total - n || literals > data.size() - at) {
+            broken = true;
+            return false;
+        }
+        n += std::size_t(zeros);
+        for (uint64_t l = 0; l < literals; ++l, ++n) {
+            const int p = int(n / std::size_t(height * bytes));
+            const int y = int(n / std::size_t(bytes)) % height;
+            const int b = int(n % std::size_t(bytes));
+            auto& row = current.planes[p][y];
+            setRowByte(row, b, Byte(rowByte(row, b) ^ data[at++]));
+        }
+    }
+
+    frame = current;
+    return true;
+}
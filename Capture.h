@@ -0,0 +1,117 @@
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Chip8.h"
+#include "Extended.h"
+#include "Frontend.h"
+#include "ThreadPool.h"
+
+// What a rom displayed, frame by frame, without a window: the screens go into a frame stream file,
+// chip8-frames turns that into PNGs or raw video.
+//
+// Frame stream ("C8FS"): u32 version (FrameStreamVersion), u32 0, then one record per changed screen:
+//   varint frames since the previous record (> 0), u8 mode (0 == 64x32, 1 == 128x64),
+//   the two planes as rows of packed bytes (MSB == leftmost pixel), XORed with the previous record's,
+//   as alternating varint runs: zero bytes, then literal bytes followed by the literals, until the planes are full.
+// Then a varint 0 and a varint with the number of frames. A size change compares against an empty screen.
+// Varints are little endian base 128. A screen that doesn't change costs nothing, a changed sprite a few bytes.
+const uint32_t FrameStreamVersion = 1;
+
+// Encodes off the emulation thread, on a ThreadPool shared by the encoders of a batch (see runBatch),
+// or on the calling thread if there is none. add() only compares the screen with the previous one
+// and, if it changed, copies the words in use into a fixed ring of two halves of 'batchWords' words
+// (256 KB, a thousand lo-res screens). A full half goes to the pool as one task while the other one
+// fills, so a pool thread wakes once per half and not on every frame. add() waits only if the other
+// half of this encoder still isn't encoded by then.
+class FrameEncoder {
+public:
+    explicit FrameEncoder(ThreadPool* encoders, std::size_t batchWords = 32768);
+    ~FrameEncoder();
+
+    FrameEncoder(FrameEncoder const&) = delete;
+    FrameEncoder& operator = (FrameEncoder const&) = delete;
+
+    bool open(std::string const& path);
+
+    // the screen after the emulated frame 'number' (counting from 1, increasing)
+    void add(uint64_t number, Rows<32> const& screen);
+    void add(uint64_t number, ExtendedChip8 const& chip);
+
+    // waits for the encoder, writes the end; false if something couldn't be written
+    bool close(uint64_t frames);
+
+    uint64_t stalls() const { return stallCount; } // add() calls that had to wait for the encoder
+    uint64_t bytes() const { return byteCount; }   // written, valid after close()
+
+private:
+    // a screen as the stream has it: plane 0 then plane 1, row by row, width / 64 words per row;
+    // only the first 'used' words are in the ring, the rest of the planes is empty (a Chip8 has no plane 1)
+    struct Record {
+        uint64_t number = 0;
+        Byte     mode = 0;  // as in the stream
+        int      used = 0;
+
+        int size() const { return mode == 0 ? 2 * Chip8::ScreenHeight : 4 * ExtendedChip8::HiresHeight; }
+    };
+
+    uint64_t* claim(uint64_t number, Byte mode, int used); // the ring words of a changed screen
+    void hand();   // the filling half to the pool (or encodes it right away)
+    bool finish(); // waits until the half in the pool is encoded, false if it already was
+    void write(Record const& screen, uint64_t const* words);
+
+    ThreadPool*       encoders;
+    std::size_t       batchWords;
+    std::size_t       halfRecords; // a lo-res Chip8 screen is the smallest record
+    bool              isOpen = false;
+
+    std::vector<uint64_t> ring;    // two halves of 'batchWords' words
+    std::vector<Record>   records; // two halves of 'halfRecords'
+
+    int               half = 0;     // producer: the filling half
+    std::size_t       filled = 0;   // producer: words in it
+    std::size_t       count = 0;    // producer: records in it
+    Record            last;         // producer: the previous changed screen
+    uint64_t const*   lastWords = nullptr; // in the ring, read only until the half is filled again
+    uint64_t          latest = 0;   // producer: the number of the last add()
+    uint64_t          stallCount = 0;
+
+    std::mutex              mutex;
+    std::condition_variable done;
+    bool                    encoding = false; // the other half is in the pool
+
+    Record            previous;     // encoder: the previously encoded screen
+    std::array<uint64_t, 2 * ExtendedChip8::HiresHeight * 2> previousWords = {}; // all words set
+    std::ofstream     file;
+    std::vector<Byte> out;
+    std::size_t       outSize = 0;
+    uint64_t          byteCount = 0;
+};
+
+// Reads a frame stream back, one changed screen at a time.
+class FrameDecoder {
+public:
+    // false if the file can't be read or isn't a frame stream of this version
+    bool open(std::string const& path);
+
+    // the next changed screen (with its frame number); false at the end of the stream or if it's damaged
+    bool next(Frame& frame);
+
+    bool damaged() const { return broken; }
+    uint64_t frames() const { return frameCount; } // emulated frames, known after next() returned false
+
+private:
+    bool varint(uint64_t& value);
+
+    std::vector<Byte> data;
+    std::size_t       at = 0;
+    Frame             current;
+    bool              broken = false;
+    uint64_t          frameCount = 0;
+};
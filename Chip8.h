@@ -1,16 +1,21 @@
 #pragma once
 
 #include <array>
+#include <cstdint>
+#include <ostream>
+#include <type_traits>
 
 // typedefs
 using Byte   = uint8_t;  // big-endian
 using Word   = uint16_t; // for this emulator, a word is defined as two bytes
 using OpCode = uint16_t; // max 35
 using Pixel  = uint8_t;  // chip8 has only black/white as color
+using Row    = uint64_t; // one line of the screen, one bit per pixel
 
 template <std::size_t N> using Bytes  = std::array<Byte, N>;
 template <std::size_t N> using Words  = std::array<Word, N>;
 template <std::size_t N> using Pixels = std::array<Pixel, N>;
+template <std::size_t N> using Rows   = std::array<Row, N>;
 
 enum Register {
     V0, V1, V2, V3,
@@ -20,6 +25,48 @@ enum Register {
     VMAX
 };
 
+// what happens to sprite pixels that are drawn over the right/bottom edge of the screen
+enum class Edges {
+    Wrap, // continue on the other side
+    Clip  // cut off
+};
+
+// The CHIP-8 interpreters that roms were written for disagree on a few opcodes.
+enum class Dialect {
+    CosmacVip, // the original interpreter of the RCA COSMAC VIP
+    Chip48,    // CHIP-48 on the HP-48 calculators
+    SuperChip, // SUPER-CHIP 1.1
+    Modern     // what current interpreters (Octo, XO-CHIP) do
+};
+
+// what Fx55/Fx65 leave in I
+enum class IndexQuirk {
+    AddXPlusOne, // I += x + 1
+    AddX,        // I += x
+    Unchanged
+};
+
+struct Quirks {
+    bool       shiftVy;  // 8xy6/8xyE: Vx := Vy shifted, otherwise Vx is shifted in place
+    bool       resetVF;  // 8xy1/8xy2/8xy3 set VF to 0
+    bool       jumpVx;   // Bxnn jumps to xnn + Vx instead of nnn + V0
+    IndexQuirk index;    // Fx55/Fx65
+    Edges      edges;    // Dxyn
+};
+
+// The handlers that depend on a quirk are templates on the dialect and decode() picks the
+// instantiation, so the quirks are compile time constants there and never checked while executing.
+constexpr Quirks quirks(Dialect dialect)
+{
+    switch (dialect) {
+    case Dialect::CosmacVip: return { true,  true,  false, IndexQuirk::AddXPlusOne, Edges::Clip };
+    case Dialect::Chip48:    return { false, false, true,  IndexQuirk::AddX,        Edges::Clip };
+    case Dialect::SuperChip: return { false, false, true,  IndexQuirk::Unchanged,   Edges::Clip };
+    case Dialect::Modern:    break;
+    }
+    return { true, false, false, IndexQuirk::AddXPlusOne, Edges::Wrap };
+}
+
 const Pixel Black        = 0;
 const Pixel White        = 1;
 const Byte  Pressed      = 1;
@@ -43,6 +90,24 @@ const Byte Font[] = {
     0xF0, 0x80, 0xF0, 0x80, 0x80  // F
 };
 
+struct Chip8;
+struct Instruction;
+
+// an opcode handler executes one already decoded instruction
+using Handler = void (*)(Chip8&, Instruction const&);
+
+// An opcode after decoding: the handler that implements it plus the operands that
+// would otherwise be re-extracted from the opcode on every execution.
+struct Instruction {
+    Handler execute = nullptr; // nullptr == not decoded yet
+    OpCode  op      = 0;
+    Word    nnn     = 0;
+    Byte    x       = 0;
+    Byte    y       = 0;
+    Byte    nn      = 0;
+    Byte    writes  = 0; // number of bytes written to memory[I...] (Fx33, Fx55)
+};
+
 // ref for Chip8 data taken from: https://en.wikipedia.org/wiki/Chip-8#Virtual_machine_description
 struct Chip8 {
 
@@ -50,9 +115,9 @@ struct Chip8 {
     const static int  WorkingMemory = 4096 - StartAddress;
 
     // data
-    Words<4096>  memory = {};
+    Bytes<4096>  memory = {};
     Words<16>    stack = {};
-    Pixels<2048> screen = {};
+    Rows<32>     screen = {}; // one bit per pixel, x == 0 is the highest bit of a row
     Bytes<16>    key = {};
 
     // constants
@@ -60,22 +125,84 @@ struct Chip8 {
     static constexpr Pixel ScreenHeight = 32;
 
     // register
-    Words<16> V = {}; // V-register, data register
+    Bytes<16> V = {}; // V-register, data register
     Word      I = 0; // index register
 
     // indices
-    Word   SI = 0;            // stack-index of current stack level
+    Byte   SI = 0;            // stack-index of current stack level
     Word   PC = StartAddress; // program counter
 
     // timer
-    Word delayTimer = 0;
-    Word soundTimer = 0;
+    Byte delayTimer = 0;
+    Byte soundTimer = 0;
+
+    // state of the random number generator used by Cxnn (xorshift32, never 0)
+    uint32_t rng = 0x2545F491;
+
+    // The whole machine as a fixed, compiler independent blob (layout in Chip8.cpp).
+    // Used for snapshots, the rewind buffer and save-state files.
+    static constexpr std::size_t StateSize = 4096 + 32 * 8 + 16 * 2 + 16 + 16 + 2 + 2 + 1 + 1 + 1 + 4;
+    using State = Bytes<StateSize>;
 
     // methods
-    void emulate(OpCode op);
+    void emulate(OpCode op, Dialect dialect = Dialect::Modern);
+    void execute(Instruction const& in);
+    void updateTimer();
     OpCode currentOp() const;
+    // the 2nnn at PC would overflow the stack or the 00EE at PC underflow it, the handlers stand still there
+    bool stackFault() const;
+
+    Pixel pixel(int x, int y) const;
+
+    // Cxnn always produces the same numbers for the same seed
+    void seed(uint32_t value);
+    Byte random();
+
+    // copies the font to 0x000 and the rom to StartAddress; false if the rom doesn't fit
+    bool load(Byte const* rom, std::size_t size);
+
+    void save(State& state) const;
+    void restore(State const& state);
 
 };
 
+// The whole machine is ~4.4 KB: it fits into L1 and can be copied with a plain memcpy (snapshots, many instances).
+static_assert(sizeof(Chip8) <= 4432, "Chip8 state grew, check the layout");
+static_assert(std::is_trivially_copyable<Chip8>::value, "Chip8 has to stay copyable with memcpy");
+
+// what executing an unknown opcode does
+enum class OnUnknown {
+    Assert, // prints the opcode and asserts
+    Halt    // nothing, PC stays on it; for headless runs, which check known() instead of aborting
+};
+
+// Splits an opcode into handler and operands. Unknown opcodes decode to a handler that reports them.
+// The quirks of the dialect are chosen here, so the handlers don't have to check them.
+Instruction decode(OpCode op, Dialect dialect = Dialect::Modern, OnUnknown onUnknown = OnUnknown::Assert);
+
+// false if 'in' decoded to the handler that reports an unknown opcode
+bool known(Instruction const& in);
+
+// The timers are not touched here, they tick at 60 Hz (see Scheduler.h).
+inline void Chip8::execute(Instruction const& in)
+{
+    // move one instruction forward == 2 bytes
+    PC += 2;
+    in.execute(*this, in);
+}
+
+inline Byte Chip8::random()
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return Byte(rng >> 24);
+}
+
+inline Pixel Chip8::pixel(int x, int y) const
+{
+    return (screen[y] >> (63 - x)) & 1 ? White : Black;
+}
+
 // full debug output
 std::ostream& operator << (std::ostream& os, Chip8 const& c);
\ No newline at end of file
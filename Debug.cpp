@@ -0,0 +1,126 @@
+// Runs one rom under the Debugger, controlled through a local socket (see DebugServer.h), no SDL involved.
+//
+//   chip8-debug [options] rom
+//
+//   --socket PATH  the command socket (default chip8-debug.sock)
+//   --ipf N        instructions per 60 Hz frame (default 10)
+//   --dialect D    vip | chip48 | schip | modern (default modern)
+//   --seed N       seed of Cxnn (default 1)
+//   --trace N      instructions kept in the trace (default 4096)
+//   --break ADDR   breakpoint at ADDR (hex), may be given several times
+//   --turbo        don't wait for the next frame, run as fast as possible
+//
+// Starts paused, "continue" on the socket starts the rom. Roms that need SUPER-CHIP/XO-CHIP
+// can't be debugged.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DebugServer.h"
+#include "Debugger.h"
+#include "Dialects.h"
+#include "Extended.h"
+#include "RomLibrary.h"
+
+
+namespace {
+
+    void usage()
+    {
+        std::cout << "usage: chip8-debug [--socket PATH] [--ipf N] [--dialect D] [--seed N] [--trace N] [--break ADDR] [--turbo] rom\n";
+    }
+
+}
+
+int main(int argc, char** argv)
+{
+    std::string socketPath = "chip8-debug.sock";
+    unsigned    ipf        = 10;
+    Dialect     dialect    = Dialect::Modern;
+    uint32_t    seed       = 1;
+    std::size_t traceSize  = 4096;
+    bool        turbo      = false;
+
+    std::vector<Word> breakpoints;
+    std::string romPath;
+    for (int n = 1; n < argc; ++n) {
+        const std::string arg = argv[n];
+        const bool hasValue = n + 1 < argc;
+
+        if (arg == "--socket" && hasValue)     { socketPath = argv[++n]; }
+        else if (arg == "--ipf" && hasValue)   { ipf = unsigned(std::strtoul(argv[++n], nullptr, 10)); }
+        else if (arg == "--seed" && hasValue)  { seed = uint32_t(std::strtoul(argv[++n], nullptr, 10)); }
+        else if (arg == "--trace" && hasValue) { traceSize = std::strtoul(argv[++n], nullptr, 10); }
+        else if (arg == "--break" && hasValue) { breakpoints.push_back(Word(std::strtoul(argv[++n], nullptr, 16))); }
+        else if (arg == "--turbo")             { turbo = true; }
+        else if (arg == "--dialect" && hasValue) {
+            if (!parseDialect(argv[++n], dialect)) { usage(); return EXIT_FAILURE; }
+        }
+        else if (arg.rfind("--", 0) == 0)      { usage(); return EXIT_FAILURE; }
+        else                                   { romPath = arg; }
+    }
+
+    RomLibrary library;
+    if (romPath.empty()) {
+        usage();
+        return EXIT_FAILURE;
+    }
+    if (!library.addFile(romPath)) {
+        std::cout << "Can't read rom " << romPath << '\n';
+        return EXIT_FAILURE;
+    }
+    Rom const& rom = library.roms().front();
+
+    Extension extension = Extension::SuperChip;
+    if (needsExtended(rom.data, rom.size, extension)) {
+        std::cout << romPath << " needs SUPER-CHIP/XO-CHIP, the debugger only runs chip8 roms\n";
+        return EXIT_FAILURE;
+    }
+
+    Chip8 chip;
+    chip.seed(seed);
+    if (!chip.load(rom.data, rom.size)) {
+        std::cout << "Rom " << romPath << " is too big\n";
+        return EXIT_FAILURE;
+    }
+
+    Debugger debugger(chip, dialect, ipf, traceSize);
+    for (auto pc : breakpoints) {
+        debugger.addBreakpoint(pc);
+    }
+
+    DebugServer server(debugger);
+    if (!server.open(socketPath)) {
+        std::cout << "Can't listen on " << socketPath << '\n';
+        return EXIT_FAILURE;
+    }
+    std::cout << "Debugging " << romPath << ", commands on " << socketPath << '\n';
+
+    // one frame at a time, the commands are looked at between the frames
+    auto deadline = std::chrono::steady_clock::now();
+    while (!server.quitting()) {
+        const bool wasPaused = server.paused();
+        server.poll();
+        if (server.paused() || server.quitting()) {
+            continue; // paused by a command, poll() waits for the next one
+        }
+        if (wasPaused) {
+            deadline = std::chrono::steady_clock::now();
+        }
+
+        const Stop stop = debugger.runFrame();
+        if (stop.reason != StopReason::Steps) {
+            server.stopped(stop);
+        }
+
+        if (!turbo) {
+            deadline += std::chrono::nanoseconds(1000000000 / 60);
+            std::this_thread::sleep_until(deadline);
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,337 @@
+#include "DebugServer.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CHIP8_SOCKET 1
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#else
+#define CHIP8_SOCKET 0
+#endif
+
+
+namespace {
+
+#if CHIP8_SOCKET && defined(MSG_NOSIGNAL)
+    const int SendFlags = MSG_NOSIGNAL; // a client that went away must not kill us with SIGPIPE
+#else
+    const int SendFlags = 0;
+#endif
+
+    // the whole word as a number in 'base', 0 == decimal or hex with 0x
+    bool number(std::string const& word, int base, unsigned long limit, unsigned long& value)
+    {
+        if (base == 0) {
+            base = word.rfind("0x", 0) == 0 ? 16 : 10;
+        }
+        if (word.empty() || word[0] == '-' || word[0] == '+') {
+            return false;
+        }
+        char* end = nullptr;
+        value = std::strtoul(word.c_str(), &end, base);
+        return *end == '\0' && value <= limit;
+    }
+
+    bool address(std::string const& word, Word& value)
+    {
+        unsigned long parsed = 0;
+        if (!number(word, 16, 0x0FFF, parsed)) {
+            return false;
+        }
+        value = Word(parsed);
+        return true;
+    }
+
+    bool reg(std::string const& word, Byte& value)
+    {
+        if (word == "I" || word == "i") {
+            value = Condition::Index;
+            return true;
+        }
+        unsigned long parsed = 0;
+        if (word.size() != 2 || (word[0] != 'V' && word[0] != 'v') || !number(word.substr(1), 16, 0xF, parsed)) {
+            return false;
+        }
+        value = Byte(parsed);
+        return true;
+    }
+
+    bool compare(std::string const& word, Condition::Compare& value)
+    {
+        static const std::pair<char const*, Condition::Compare> symbols[] = {
+            { "==", Condition::Compare::Equal },   { "!=", Condition::Compare::NotEqual },
+            { "<",  Condition::Compare::Less },    { "<=", Condition::Compare::LessEqual },
+            { ">",  Condition::Compare::Greater }, { ">=", Condition::Compare::GreaterEqual }
+        };
+        for (auto const& symbol : symbols) {
+            if (word == symbol.first) {
+                value = symbol.second;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::ostream& hex(std::ostream& os, unsigned value, int width)
+    {
+        return os << std::hex << std::setfill('0') << std::setw(width) << value << std::dec;
+    }
+
+}
+
+DebugServer::DebugServer(Debugger& debugger)
+    : debugger(debugger)
+{
+}
+
+DebugServer::~DebugServer()
+{
+#if CHIP8_SOCKET
+    if (client >= 0) {
+        close(client);
+    }
+    if (listener >= 0) {
+        close(listener);
+        unlink(path.c_str());
+    }
+#endif
+}
+
+bool DebugServer::open(std::string const& socketPath)
+{
+#if CHIP8_SOCKET
+    sockaddr_un name = {};
+    name.sun_family = AF_UNIX;
+    if (socketPath.empty() || socketPath.size() >= sizeof(name.sun_path)) {
+        return false;
+    }
+    std::memcpy(name.sun_path, socketPath.c_str(), socketPath.size());
+
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        return false;
+    }
+    unlink(socketPath.c_str());
+    if (bind(listener, reinterpret_cast<sockaddr const*>(&name), sizeof(name)) != 0 || listen(listener, 1) != 0) {
+        close(listener);
+        listener = -1;
+        return false;
+    }
+    path = socketPath;
+    return true;
+#else
+    (void)socketPath;
+    return false;
+#endif
+}
+
+void DebugServer::poll()
+{
+#if CHIP8_SOCKET
+    // running, this only looks; paused, it waits for the client (or a new one) until it resumes
+    do {
+        pollfd fd = { client >= 0 ? client : listener, POLLIN, 0 };
+        if (fd.fd < 0 || ::poll(&fd, 1, isPaused ? -1 : 0) <= 0) {
+            return;
+        }
+
+        if (client < 0) {
+            client = accept(listener, nullptr, nullptr);
+            if (client >= 0) {
+                send(isPaused ? "paused\nok\n" : "running\nok\n");
+            }
+            continue;
+        }
+
+        char buffer[512];
+        const auto received = recv(client, buffer, sizeof(buffer), 0);
+        if (received <= 0) {
+            close(client);
+            client = -1;
+            input.clear();
+            continue;
+        }
+        input.append(buffer, std::size_t(received));
+
+        for (auto end = input.find('\n'); end != std::string::npos && !isQuitting; end = input.find('\n')) {
+            const std::string line = input.substr(0, end);
+            input.erase(0, end + 1);
+            send(execute(line));
+        }
+    } while (isPaused && !isQuitting);
+#endif
+}
+
+void DebugServer::stopped(Stop const& stop)
+{
+    isPaused = true;
+    std::ostringstream out;
+    describe(out << "stopped ", stop);
+    send(out.str());
+}
+
+void DebugServer::send(std::string const& text)
+{
+#if CHIP8_SOCKET
+    for (std::size_t sent = 0; client >= 0 && sent < text.size(); ) {
+        const auto n = ::send(client, text.data() + sent, text.size() - sent, SendFlags);
+        if (n <= 0) {
+            close(client);
+            client = -1;
+            input.clear();
+            return;
+        }
+        sent += std::size_t(n);
+    }
+#else
+    (void)text;
+#endif
+}
+
+std::string DebugServer::execute(std::string const& line)
+{
+    std::istringstream in(line);
+    std::vector<std::string> words;
+    for (std::string word; in >> word; ) {
+        words.push_back(word);
+    }
+
+    std::ostringstream out;
+    auto error = [&out](char const* what) {
+        out << "error " << what << '\n';
+        return out.str();
+    };
+    if (words.empty()) {
+        return error("empty command");
+    }
+
+    Chip8& chip = debugger.machine();
+    std::string const& command = words[0];
+    Word first = 0;
+    Word last = 0;
+    unsigned long count = 0;
+
+    if (command == "break") {
+        if ((words.size() != 2 && words.size() != 5) || !address(words[1], first)) {
+            return error("usage: break ADDR [REG OP VALUE]");
+        }
+        if (words.size() == 2) {
+            debugger.addBreakpoint(first);
+        }
+        else {
+            Condition condition;
+            if (!reg(words[2], condition.reg) || !compare(words[3], condition.compare) || !number(words[4], 0, 0xFFFF, count)) {
+                return error("usage: break ADDR [REG OP VALUE]");
+            }
+            condition.value = Word(count);
+            debugger.addBreakpoint(first, condition);
+        }
+    }
+    else if (command == "delete") {
+        if (words.size() != 2 || !address(words[1], first)) {
+            return error("usage: delete ADDR");
+        }
+        if (!debugger.removeBreakpoints(first)) {
+            return error("no breakpoint there");
+        }
+    }
+    else if (command == "watch" || command == "unwatch") {
+        if (words.size() < 2 || words.size() > 3 || !address(words[1], first) ||
+            !address(words.size() == 3 ? words[2] : words[1], last) || last < first) {
+            return error("usage: watch|unwatch FIRST [LAST]");
+        }
+        if (command == "watch") {
+            debugger.addWatchpoint(first, last);
+        }
+        else if (!debugger.removeWatchpoint(first, last)) {
+            return error("no such watchpoint");
+        }
+    }
+    else if (command == "list") {
+        debugger.list(out);
+    }
+    else if (command == "continue") {
+        isPaused = false;
+    }
+    else if (command == "pause") {
+        isPaused = true;
+        hex(out << "paused at ", chip.PC, 3) << '\n';
+    }
+    else if (command == "step") {
+        count = 1;
+        if (words.size() > 2 || (words.size() == 2 && !number(words[1], 0, 0xFFFFFFFF, count))) {
+            return error("usage: step [N]");
+        }
+        isPaused = true;
+        describe(out, debugger.run(count));
+    }
+    else if (command == "regs") {
+        dump(out, chip);
+    }
+    else if (command == "mem") {
+        count = 16;
+        if (words.size() < 2 || words.size() > 3 || !address(words[1], first) ||
+            (words.size() == 3 && !number(words[2], 0, 4096, count))) {
+            return error("usage: mem ADDR [COUNT]");
+        }
+        for (unsigned long n = 0; n < count; ++n) {
+            const Word addr = Word((first + n) & 0x0FFF);
+            if (n % 16 == 0) {
+                hex(out << (n > 0 ? "\n" : ""), addr, 3) << ':';
+            }
+            hex(out << ' ', chip.memory[addr], 2);
+        }
+        out << '\n';
+    }
+    else if (command == "trace") {
+        count = 16;
+        if (words.size() > 2 || (words.size() == 2 && !number(words[1], 0, 0xFFFFFFFF, count))) {
+            return error("usage: trace [N]");
+        }
+        for (auto const& record : debugger.trace(count)) {
+            hex(out, record.pc, 3);
+            hex(out << ' ', record.op, 4);
+            if (record.changed) {
+                hex(hex(out << "  v", record.reg, 1) << '=', record.value, 2);
+                for (int n = 0; n < 16; ++n) {
+                    if (record.changed & (1 << n) && n != record.reg) {
+                        hex(out << " +v", unsigned(n), 1);
+                    }
+                }
+            }
+            out << '\n';
+        }
+    }
+    else if (command == "screen") {
+        for (int y = 0; y < Chip8::ScreenHeight; ++y) {
+            for (int x = 0; x < Chip8::ScreenWidth; ++x) {
+                out << (chip.pixel(x, y) == White ? '#' : '.');
+            }
+            out << '\n';
+        }
+    }
+    else if (command == "keys") {
+        if (words.size() != 2 || !number(words[1], 16, 0xFFFF, count)) {
+            return error("usage: keys MASK");
+        }
+        for (int n = 0; n < 16; ++n) {
+            chip.key[n] = (count >> n) & 1 ? Pressed : 0;
+        }
+    }
+    else if (command == "quit") {
+        isQuitting = true;
+    }
+    else {
+        return error("unknown command");
+    }
+
+    out << "ok\n";
+    return out.str();
+}
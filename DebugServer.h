@@ -0,0 +1,61 @@
+#pragma once
+
+#include <string>
+
+#include "Debugger.h"
+
+// Text commands for a Debugger over a local socket (a unix domain socket), one per line.
+// Any client will do, "socat - UNIX-CONNECT:chip8-debug.sock" for example.
+// Addresses and key masks are hex, values decimal (or hex with 0x).
+//
+//   break ADDR [REG OP VALUE]  breakpoint, REG is V0..VF or I, OP one of == != < <= > >=
+//   delete ADDR                removes the breakpoints at ADDR
+//   watch FIRST [LAST]         stops after an Fx33/Fx55 wrote into FIRST..LAST
+//   unwatch FIRST [LAST]
+//   list                       breakpoints and watchpoints
+//   continue, pause
+//   step [N]                   N instructions (default 1)
+//   regs                       V, I, PC, stack, timers and keys
+//   mem ADDR [COUNT]           COUNT bytes (default 16)
+//   trace [N]                  the last N instructions (default 16) with the register they changed
+//   screen
+//   keys MASK                  bit n == key n is down
+//   quit
+//
+// Every answer ends with a line "ok" or "error <what went wrong>". When the running machine stops
+// on its own, "stopped <why>" is sent (see describe()).
+class DebugServer {
+public:
+    explicit DebugServer(Debugger& debugger);
+    ~DebugServer();
+
+    DebugServer(DebugServer const&) = delete;
+    DebugServer& operator = (DebugServer const&) = delete;
+
+    // listens on 'path', a stale socket file is replaced; false if it can't (or there are no local sockets)
+    bool open(std::string const& path);
+
+    // accepts a client and executes what it sent; while paused it waits until a command resumes
+    void poll();
+
+    // the running machine stopped: tells the client and pauses
+    void stopped(Stop const& stop);
+
+    // one command line and its answer, independent of the socket
+    std::string execute(std::string const& line);
+
+    bool paused() const { return isPaused; }
+    bool quitting() const { return isQuitting; }
+
+private:
+    void send(std::string const& text);
+
+    Debugger&   debugger;
+    bool        isPaused = true;
+    bool        isQuitting = false;
+
+    std::string path;
+    std::string input;
+    int         listener = -1;
+    int         client = -1;
+};
@@ -0,0 +1,277 @@
+#include "Debugger.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <utility>
+
+
+namespace {
+
+    constexpr Word AddressMask = 0x0FFF;
+
+    std::ostream& hex(std::ostream& os, unsigned value, int width)
+    {
+        return os << std::hex << std::setfill('0') << std::setw(width) << value << std::dec;
+    }
+
+    char const* symbol(Condition::Compare compare)
+    {
+        switch (compare) {
+        case Condition::Compare::Equal:        return "==";
+        case Condition::Compare::NotEqual:     return "!=";
+        case Condition::Compare::Less:         return "<";
+        case Condition::Compare::LessEqual:    return "<=";
+        case Condition::Compare::Greater:      return ">";
+        case Condition::Compare::GreaterEqual: return ">=";
+        }
+        return "?";
+    }
+
+}
+
+bool Condition::holds(Chip8 const& chip) const
+{
+    const Word actual = reg == Index ? chip.I : chip.V[reg & 0x0F];
+    switch (compare) {
+    case Compare::Equal:        return actual == value;
+    case Compare::NotEqual:     return actual != value;
+    case Compare::Less:         return actual < value;
+    case Compare::LessEqual:    return actual <= value;
+    case Compare::Greater:      return actual > value;
+    case Compare::GreaterEqual: return actual >= value;
+    }
+    return false;
+}
+
+Debugger::Debugger(Chip8& chip, Dialect dialect, unsigned instructionsPerFrame, std::size_t traceSize)
+    : chip(chip)
+    , engine(chip, dialect)
+    , instructionsPerFrame(std::max(1u, instructionsPerFrame))
+{
+    std::size_t size = 1;
+    while (size < traceSize) {
+        size *= 2;
+    }
+    ring.resize(size);
+    ringMask = size - 1;
+}
+
+void Debugger::addBreakpoint(Word pc)
+{
+    breakpoints.push_back({ Word(pc & AddressMask), false, Condition{} });
+    breakAt.set(pc & AddressMask);
+}
+
+void Debugger::addBreakpoint(Word pc, Condition const& condition)
+{
+    breakpoints.push_back({ Word(pc & AddressMask), true, condition });
+    breakAt.set(pc & AddressMask);
+}
+
+bool Debugger::removeBreakpoints(Word pc)
+{
+    pc &= AddressMask;
+    const auto size = breakpoints.size();
+    breakpoints.erase(std::remove_if(breakpoints.begin(), breakpoints.end(), [pc](Breakpoint const& b) { return b.pc == pc; }),
+                      breakpoints.end());
+    breakAt.reset(pc);
+    return breakpoints.size() != size;
+}
+
+void Debugger::addWatchpoint(Word first, Word last)
+{
+    watchpoints.emplace_back(Word(first & AddressMask), Word(last & AddressMask));
+    rebuildWatched();
+}
+
+bool Debugger::removeWatchpoint(Word first, Word last)
+{
+    const auto found = std::find(watchpoints.begin(), watchpoints.end(), std::make_pair(Word(first & AddressMask), Word(last & AddressMask)));
+    if (found == watchpoints.end()) {
+        return false;
+    }
+    watchpoints.erase(found);
+    rebuildWatched();
+    return true;
+}
+
+void Debugger::rebuildWatched()
+{
+    watched.reset();
+    for (auto const& range : watchpoints) {
+        for (int addr = range.first; addr <= range.second; ++addr) {
+            watched.set(std::size_t(addr));
+        }
+    }
+}
+
+bool Debugger::breaks() const
+{
+    for (auto const& b : breakpoints) {
+        if (b.pc == (chip.PC & AddressMask) && (!b.conditional || b.condition.holds(chip))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+Stop Debugger::run(uint64_t steps)
+{
+    Stop stop;
+
+    // the breakpoint run() stopped at last time is where it continues now
+    const bool resuming = std::exchange(stoppedAtBreakpoint, false);
+
+    for (; stop.executed < steps; ++stop.executed) {
+        stop.pc = chip.PC;
+
+        if (breakAt[chip.PC & AddressMask] && (stop.executed > 0 || !resuming) && breaks()) {
+            stop.reason = StopReason::Breakpoint;
+            stoppedAtBreakpoint = true;
+            return stop;
+        }
+
+        // copied, step() may throw the cache entry away
+        const Instruction in = engine.fetch();
+        if (!known(in)) {
+            stop.reason = StopReason::UnknownOpcode;
+            return stop;
+        }
+        if (chip.stackFault()) {
+            stop.reason = StopReason::StackFault;
+            return stop;
+        }
+
+        // the bytes an Fx33/Fx55 is about to write, I may move during the execution
+        bool hit = false;
+        for (int n = 0; n < in.writes && !hit; ++n) {
+            const Word addr = (chip.I + n) & AddressMask;
+            if (watched[addr]) {
+                hit = true;
+                stop.address = addr;
+                stop.before = chip.memory[addr];
+            }
+        }
+
+        const Bytes<16> before = chip.V;
+        engine.step();
+
+        TraceRecord& record = ring[total & ringMask];
+        record = TraceRecord{};
+        record.pc = stop.pc;
+        record.op = in.op;
+        for (int n = 15; n >= 0; --n) {
+            if (chip.V[n] != before[n]) {
+                record.changed |= uint16_t(1 << n);
+                record.reg = Byte(n);
+                record.value = chip.V[n];
+            }
+        }
+        total++;
+
+        if (++frameCycle == instructionsPerFrame) {
+            frameCycle = 0;
+            frameCount++;
+            chip.updateTimer();
+        }
+
+        if (hit) {
+            stop.reason = StopReason::Watchpoint;
+            stop.after = chip.memory[stop.address];
+            stop.executed++;
+            return stop;
+        }
+    }
+
+    stop.pc = chip.PC;
+    return stop;
+}
+
+std::vector<TraceRecord> Debugger::trace(std::size_t count) const
+{
+    count = std::min<uint64_t>({ count, total, ring.size() });
+    std::vector<TraceRecord> records;
+    records.reserve(count);
+    for (uint64_t n = total - count; n < total; ++n) {
+        records.push_back(ring[n & ringMask]);
+    }
+    return records;
+}
+
+void Debugger::reset()
+{
+    engine.clear();
+    stoppedAtBreakpoint = false;
+    frameCycle = 0;
+}
+
+void Debugger::list(std::ostream& os) const
+{
+    for (auto const& b : breakpoints) {
+        hex(os << "break ", b.pc, 3);
+        if (b.conditional) {
+            os << ' ';
+            if (b.condition.reg == Condition::Index) {
+                os << 'I';
+            }
+            else {
+                hex(os << 'V', b.condition.reg, 1);
+            }
+            os << ' ' << symbol(b.condition.compare) << ' ' << b.condition.value;
+        }
+        os << '\n';
+    }
+    for (auto const& w : watchpoints) {
+        hex(hex(os << "watch ", w.first, 3) << ' ', w.second, 3) << '\n';
+    }
+}
+
+void dump(std::ostream& os, Chip8 const& chip)
+{
+    hex(os << "pc ", chip.PC, 3);
+    hex(os << "  op ", chip.currentOp(), 4);
+    hex(os << "  i ", chip.I, 3);
+    os << "  sp " << int(chip.SI);
+    hex(os << "  dt ", chip.delayTimer, 2);
+    hex(os << "  st ", chip.soundTimer, 2) << '\n';
+
+    for (int n = 0; n < 16; ++n) {
+        hex(hex(os << 'v', unsigned(n), 1) << ' ', chip.V[n], 2) << (n % 8 == 7 ? '\n' : ' ');
+    }
+
+    os << "stack";
+    for (int n = 0; n < chip.SI && n < 16; ++n) {
+        hex(os << ' ', chip.stack[n], 3);
+    }
+    os << '\n';
+
+    unsigned keys = 0;
+    for (int n = 0; n < 16; ++n) {
+        keys |= chip.key[n] ? 1u << n : 0;
+    }
+    hex(os << "keys ", keys, 4) << '\n';
+}
+
+void describe(std::ostream& os, Stop const& stop)
+{
+    switch (stop.reason) {
+    case StopReason::Steps:
+        hex(os << "stepped " << stop.executed << ", pc ", stop.pc, 3) << '\n';
+        break;
+    case StopReason::Breakpoint:
+        hex(os << "breakpoint ", stop.pc, 3) << '\n';
+        break;
+    case StopReason::Watchpoint:
+        hex(os << "watchpoint ", stop.pc, 3);
+        hex(os << " wrote ", stop.address, 3);
+        hex(os << ": ", stop.before, 2);
+        hex(os << " -> ", stop.after, 2) << '\n';
+        break;
+    case StopReason::UnknownOpcode:
+        hex(os << "unknown opcode at ", stop.pc, 3) << '\n';
+        break;
+    case StopReason::StackFault:
+        hex(os << "stack fault at ", stop.pc, 3) << '\n';
+        break;
+    }
+}
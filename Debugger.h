@@ -0,0 +1,126 @@
+#pragma once
+
+#include <bitset>
+#include <cstdint>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+#include "Chip8.h"
+#include "DecodeCache.h"
+
+// Breakpoints, watchpoints and a trace of the last executed instructions for one Chip8.
+//
+// The engines and the Scheduler don't know about any of this. A debugged machine runs on the
+// Debugger instead, one instruction at a time through its own DecodeCache, with all the checks.
+// A machine without a debugger runs exactly the code it ran before, there is nothing to switch off.
+
+// a condition on a register: "V3 == 5", "I >= 0x300"
+struct Condition {
+    enum class Compare { Equal, NotEqual, Less, LessEqual, Greater, GreaterEqual };
+
+    static const Byte Index = 16; // 'reg' of I, 0..15 are V0..VF
+
+    Byte    reg     = V0;
+    Compare compare = Compare::Equal;
+    Word    value   = 0;
+
+    bool holds(Chip8 const& chip) const;
+};
+
+// one executed instruction, 8 bytes
+struct TraceRecord {
+    Word     pc      = 0;
+    OpCode   op      = 0;
+    uint16_t changed = 0; // bit n == Vn changed
+    Byte     reg     = 0; // the lowest changed register (if any changed)
+    Byte     value   = 0; // its new value
+};
+
+static_assert(sizeof(TraceRecord) == 8, "TraceRecord is meant to be small, the ring holds thousands of them");
+
+enum class StopReason {
+    Steps,         // executed all the instructions it was asked to
+    Breakpoint,    // at 'pc', not executed yet
+    Watchpoint,    // the Fx33/Fx55 at 'pc' wrote into a watched range, it was executed
+    UnknownOpcode, // at 'pc', not executed (it would only have asserted)
+    StackFault     // the 2nnn at 'pc' with a full stack or the 00EE with an empty one, not executed
+};
+
+struct Stop {
+    StopReason reason   = StopReason::Steps;
+    uint64_t   executed = 0;
+    Word       pc       = 0;
+    Word       address  = 0; // watchpoint: the first watched byte that was written
+    Byte       before   = 0; // and its value before and after
+    Byte       after    = 0;
+};
+
+class Debugger {
+public:
+    // the timers tick every 'instructionsPerFrame' instructions (as in Scheduler, in turbo mode);
+    // the last 'traceSize' instructions are kept, rounded up to a power of two
+    Debugger(Chip8& chip, Dialect dialect = Dialect::Modern, unsigned instructionsPerFrame = 10, std::size_t traceSize = 4096);
+
+    // breakpoints at the same address are or-ed, a conditional one only stops if its condition holds
+    void addBreakpoint(Word pc);
+    void addBreakpoint(Word pc, Condition const& condition);
+    bool removeBreakpoints(Word pc); // false if there was none
+
+    // stops after an Fx33/Fx55 wrote into [first, last]
+    void addWatchpoint(Word first, Word last);
+    bool removeWatchpoint(Word first, Word last); // false if there was no such watchpoint
+
+    // executes up to 'steps' instructions. A breakpoint at the current PC doesn't stop, so
+    // run() simply goes on after a stop.
+    Stop run(uint64_t steps);
+
+    // up to the end of the current frame
+    Stop runFrame() { return run(instructionsPerFrame - frameCycle); }
+
+    // the last 'count' executed instructions, oldest first
+    std::vector<TraceRecord> trace(std::size_t count) const;
+
+    // needed after the memory got replaced from the outside (loading a rom...)
+    void reset();
+
+    // breakpoints and watchpoints, one per line
+    void list(std::ostream& os) const;
+
+    Chip8& machine() { return chip; }
+    uint64_t executed() const { return total; }
+    uint64_t frames() const { return frameCount; }
+
+private:
+    struct Breakpoint {
+        Word      pc = 0;
+        bool      conditional = false;
+        Condition condition;
+    };
+
+    bool breaks() const;
+    void rebuildWatched();
+
+    Chip8&      chip;
+    DecodeCache engine;
+    unsigned    instructionsPerFrame;
+    unsigned    frameCycle = 0;
+    uint64_t    frameCount = 0;
+    bool        stoppedAtBreakpoint = false;
+
+    // the bitsets are the checks per instruction, the vectors what they were made from
+    std::bitset<4096>               breakAt;
+    std::vector<Breakpoint>         breakpoints;
+    std::bitset<4096>               watched;
+    std::vector<std::pair<Word, Word>> watchpoints;
+
+    std::vector<TraceRecord> ring;
+    std::size_t              ringMask = 0;
+    uint64_t                 total = 0;
+};
+
+// everything of the machine in hex: V, I, PC, the stack, timers, keys and the instruction at PC
+void dump(std::ostream& os, Chip8 const& chip);
+
+// the reason of a stop as one line: "breakpoint 2a4", "watchpoint 2b0 wrote 300: 00 -> 07"...
+void describe(std::ostream& os, Stop const& stop);
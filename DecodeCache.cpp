@@ -0,0 +1,29 @@
+#include "DecodeCache.h"
+
+
+DecodeCache::DecodeCache(Chip8& chip, Dialect dialect, OnUnknown onUnknown)
+    : chip(chip)
+    , dialect(dialect)
+    , onUnknown(onUnknown)
+{
+}
+
+void DecodeCache::run(std::size_t steps)
+{
+    for (std::size_t n = 0; n < steps; ++n) {
+        step();
+    }
+}
+
+void DecodeCache::invalidate(Word address, Word length)
+{
+    // an instruction is two bytes long, so the one starting right before 'address' is affected as well
+    for (int addr = address - 1; addr < address + length; ++addr) {
+        cache[addr & AddressMask].execute = nullptr;
+    }
+}
+
+void DecodeCache::clear()
+{
+    cache.fill(Instruction{});
+}
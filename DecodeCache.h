@@ -0,0 +1,74 @@
+#pragma once
+
+#include "Chip8.h"
+#include "Profile.h"
+
+// Faster alternative to 'chip.emulate(chip.currentOp())':
+// every word of the address space is decoded once (on first execution) and kept, indexed by PC.
+// Fx33/Fx55 write into memory, so the entries they touch are thrown away and decoded again
+// when they are reached - self-modifying ROMs still see their own changes.
+class DecodeCache {
+public:
+    explicit DecodeCache(Chip8& chip, Dialect dialect = Dialect::Modern, OnUnknown onUnknown = OnUnknown::Assert);
+
+    // the decoded instruction at PC (decodes it if necessary)
+    Instruction const& fetch();
+
+    // executes the instruction at PC
+    void step();
+
+    // executes 'steps' instructions
+    void run(std::size_t steps);
+
+    // forgets the decoded instructions that overlap [address, address + length)
+    void invalidate(Word address, Word length);
+
+    // forgets everything, needed after the memory got replaced from the outside (loading a rom...)
+    void clear();
+
+#if CHIP8_PROFILE
+    void setProfile(Profile* value) { profile = value; }
+#endif
+
+private:
+    static constexpr Word AddressMask = 0x0FFF;
+
+    Chip8& chip;
+    Dialect dialect;
+    OnUnknown onUnknown;
+    std::array<Instruction, 4096> cache = {};
+
+#if CHIP8_PROFILE
+    Profile* profile = nullptr;
+#endif
+};
+
+inline Instruction const& DecodeCache::fetch()
+{
+    auto& in = cache[chip.PC & AddressMask];
+    if (!in.execute) {
+        in = decode(chip.currentOp(), dialect, onUnknown);
+    }
+    return in;
+}
+
+inline void DecodeCache::step()
+{
+    auto const& in = fetch();
+
+    // I has to be captured before the execution, Fx55 moves it
+    const Word target = chip.I;
+#if CHIP8_PROFILE
+    const Word pc = chip.PC;
+#endif
+    chip.execute(in);
+#if CHIP8_PROFILE
+    if (profile) {
+        profile->instruction(chip, pc, in.op);
+    }
+#endif
+
+    if (in.writes) {
+        invalidate(target, in.writes);
+    }
+}
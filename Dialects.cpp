@@ -0,0 +1,92 @@
+#include "Dialects.h"
+
+#include <fstream>
+#include <sstream>
+
+#include "Hash.h"
+
+
+namespace {
+
+    struct Name {
+        Dialect     dialect;
+        const char* name;
+    };
+
+    const Name Names[] = {
+        { Dialect::CosmacVip, "vip" },
+        { Dialect::Chip48,    "chip48" },
+        { Dialect::SuperChip, "schip" },
+        { Dialect::Modern,    "modern" },
+    };
+
+}
+
+const char* toString(Dialect dialect)
+{
+    for (auto const& n : Names) {
+        if (n.dialect == dialect) {
+            return n.name;
+        }
+    }
+    return "?";
+}
+
+bool parseDialect(std::string const& name, Dialect& dialect)
+{
+    for (auto const& n : Names) {
+        if (name == n.name) {
+            dialect = n.dialect;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool DialectDatabase::load(std::string const& path)
+{
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+
+    std::unordered_map<uint64_t, Entry> parsed;
+    std::string line;
+    while (std::getline(file, line)) {
+        line = line.substr(0, line.find('#'));
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+
+        std::istringstream fields(line);
+        uint64_t romHash = 0;
+        std::string name;
+        Entry entry;
+        if (!(fields >> std::hex >> romHash >> name) || !parseDialect(name, entry.dialect)) {
+            return false;
+        }
+
+        std::getline(fields >> std::ws, entry.title);
+        while (!entry.title.empty() && (entry.title.back() == '\r' || entry.title.back() == ' ')) {
+            entry.title.pop_back();
+        }
+        parsed[romHash] = entry;
+    }
+
+    for (auto const& e : parsed) {
+        entries[e.first] = e.second;
+    }
+    return true;
+}
+
+DialectDatabase::Entry const* DialectDatabase::find(uint64_t romHash) const
+{
+    const auto it = entries.find(romHash);
+    return it != entries.end() ? &it->second : nullptr;
+}
+
+Dialect DialectDatabase::dialectOf(Byte const* rom, std::size_t size, Dialect fallback) const
+{
+    auto const* entry = find(hash(rom, size));
+    return entry ? entry->dialect : fallback;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include "Chip8.h"
+
+// names on the command line and in database files: vip, chip48, schip, modern
+const char* toString(Dialect dialect);
+bool parseDialect(std::string const& name, Dialect& dialect);
+
+// Which dialect a rom was written for, found by the hash of the rom (Hash.h, over the rom bytes only).
+// Roms for different dialects can run in one process, each with its own decode().
+// File format: one rom per line, "<hash as hex> <dialect> [title]"; '#' starts a comment.
+class DialectDatabase {
+public:
+    struct Entry {
+        Dialect     dialect = Dialect::Modern;
+        std::string title;
+    };
+
+    // adds the entries of a file; false (and nothing is added) if it can't be read or a line is broken
+    bool load(std::string const& path);
+
+    void add(uint64_t romHash, Entry const& entry) { entries[romHash] = entry; }
+
+    // nullptr if the rom is unknown
+    Entry const* find(uint64_t romHash) const;
+
+    Dialect dialectOf(Byte const* rom, std::size_t size, Dialect fallback = Dialect::Modern) const;
+
+    std::size_t size() const { return entries.size(); }
+
+private:
+    std::unordered_map<uint64_t, Entry> entries;
+};
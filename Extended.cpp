@@ -0,0 +1,502 @@
+#include "Extended.h"
+
+#include <algorithm>
+#include <bitset>
+#include <cstring>  // for std::memcpy, std::memmove
+#include <fstream>
+#include <vector>
+
+#include "Analysis.h"
+
+
+namespace {
+
+    Row rotateRight(Row row, int n)
+    {
+        return (row >> n) | (row << ((64 - n) & 63));
+    }
+
+    // xors a sprite line ('sprite' is aligned to the highest bit) into 'line' at x; true on a collision
+    bool drawLine(WideRow& line, Row sprite, int x, bool hires, bool wrap)
+    {
+        Row left  = 0;
+        Row right = 0;
+
+        if (!hires) {
+            left = wrap ? rotateRight(sprite, x) : sprite >> x;
+        }
+        else if (x < 64) {
+            left  = sprite >> x;
+            right = x > 0 ? sprite << (64 - x) : 0;
+        }
+        else {
+            right = sprite >> (x - 64);
+            if (wrap && x > 64) {
+                left = sprite << (128 - x);
+            }
+        }
+
+        const bool collision = ((line[0] & left) | (line[1] & right)) != 0;
+        line[0] ^= left;
+        line[1] ^= right;
+        return collision;
+    }
+
+    // Dxyn  draw a sprite of 8 x n pixels at (Vx, Vy), Dxy0 one of 16 x 16 pixels
+    //       Every selected plane gets its own sprite, one after the other at I.
+    //       Vf := 1 on a collision; SUPER-CHIP in hi-res counts the rows that collided or were clipped.
+    void draw(ExtendedChip8& c, OpCode op)
+    {
+        const int x = c.V[(op & 0x0F00) >> 8] % c.width();
+        const int y = c.V[(op & 0x00F0) >> 4] % c.height();
+        const int n = op & 0x000F;
+        const bool big  = n == 0;
+        const int  rows = big ? 16 : n;
+        const bool wrap = c.quirks.edges == Edges::Wrap;
+        const bool countRows = c.extension == Extension::SuperChip && c.hires;
+
+        Word address = c.I;
+        int  hitRows = 0;
+        for (auto plane = 0; plane < 2; ++plane) {
+            if (!(c.planeMask & (1 << plane))) {
+                continue;
+            }
+
+            for (int row = 0; row < rows; ++row) {
+                Row sprite = Row(c.memory[address++]) << 56;
+                if (big) {
+                    sprite |= Row(c.memory[address++]) << 48;
+                }
+
+                int line = y + row;
+                if (line >= c.height()) {
+                    if (!wrap) {
+                        hitRows += countRows ? 1 : 0; // elsewhere a clipped row is no collision
+                        continue;
+                    }
+                    line -= c.height();
+                }
+
+                hitRows += drawLine(c.planes[plane][line], sprite, x, c.hires, wrap) ? 1 : 0;
+            }
+        }
+
+        if (countRows) {
+            c.V[VF] = Byte(hitRows);
+        }
+        else {
+            c.V[VF] = hitRows > 0 ? 1 : 0;
+        }
+    }
+
+    // Scrolling moves whole packed rows: memmove for the vertical, one 128 bit shift per row for the horizontal direction.
+
+    // 00Cn  scroll down n rows
+    void scrollDown(ExtendedChip8& c, Plane& p, int n)
+    {
+        const int h = c.height();
+        n = std::min(n, h);
+        std::memmove(&p[n], &p[0], (h - n) * sizeof(WideRow));
+        std::memset(&p[0], 0, n * sizeof(WideRow));
+    }
+
+    // 00Dn  scroll up n rows
+    void scrollUp(ExtendedChip8& c, Plane& p, int n)
+    {
+        const int h = c.height();
+        n = std::min(n, h);
+        std::memmove(&p[0], &p[n], (h - n) * sizeof(WideRow));
+        std::memset(&p[h - n], 0, n * sizeof(WideRow));
+    }
+
+    // 00FB  scroll right 4 pixels
+    void scrollRight(ExtendedChip8& c, Plane& p)
+    {
+        for (int row = 0; row < c.height(); ++row) {
+            auto& line = p[row];
+            if (c.hires) {
+                line[1] = (line[1] >> 4) | (line[0] << 60);
+            }
+            line[0] >>= 4;
+        }
+    }
+
+    // 00FC  scroll left 4 pixels
+    void scrollLeft(ExtendedChip8& c, Plane& p)
+    {
+        for (int row = 0; row < c.height(); ++row) {
+            auto& line = p[row];
+            line[0] = (line[0] << 4) | (c.hires ? line[1] >> 60 : 0);
+            line[1] <<= 4;
+        }
+    }
+
+    template <typename Function>
+    void forPlanes(ExtendedChip8& c, Function f)
+    {
+        for (auto plane = 0; plane < 2; ++plane) {
+            if (c.planeMask & (1 << plane)) {
+                f(c.planes[plane]);
+            }
+        }
+    }
+
+    // skips also have to skip both words of F000 nnnn
+    void skipNext(ExtendedChip8& c)
+    {
+        const bool longOp = c.extension == Extension::XoChip && c.memory[c.PC] == 0xF0 && c.memory[Word(c.PC + 1)] == 0x00;
+        c.PC += longOp ? 4 : 2;
+    }
+
+    void moveIndex(ExtendedChip8& c, int x)
+    {
+        if (c.quirks.index == IndexQuirk::AddXPlusOne) { c.I += x + 1; }
+        if (c.quirks.index == IndexQuirk::AddX)        { c.I += x; }
+    }
+
+    bool isExtended(OpCode op, bool& xo)
+    {
+        xo = false;
+        switch (op & 0xF000) {
+        case 0x0000:
+            if ((op & 0xFFF0) == 0x00C0 && (op & 0x000F) != 0) { return true; }
+            if (op >= 0x00FB && op <= 0x00FF)                  { return true; }
+            xo = (op & 0xFFF0) == 0x00D0;
+            return xo;
+        case 0x5000:
+            xo = (op & 0x000F) == 0x2 || (op & 0x000F) == 0x3;
+            return xo;
+        case 0xD000:
+            return (op & 0x000F) == 0;
+        case 0xF000:
+            switch (op & 0x00FF) {
+            case 0x30: case 0x75: case 0x85: return true;
+            case 0x00: xo = op == 0xF000; break;
+            case 0x01: xo = true;         break;
+            case 0x02: xo = op == 0xF002; break;
+            case 0x3A: xo = true;         break;
+            }
+            return xo;
+        }
+        return false;
+    }
+
+}
+
+ExtendedChip8::ExtendedChip8(Extension extension, Dialect dialect)
+    : extension(extension)
+    , quirks(::quirks(dialect))
+{
+}
+
+OpCode ExtendedChip8::currentOp() const
+{
+    return memory[PC] << 8 | memory[Word(PC + 1)];
+}
+
+void ExtendedChip8::seed(uint32_t value)
+{
+    // xorshift gets stuck at 0
+    rng = value != 0 ? value : 0x2545F491;
+}
+
+bool ExtendedChip8::load(Byte const* rom, std::size_t size)
+{
+    const std::size_t limit = extension == Extension::XoChip ? MemorySize - StartAddress : std::size_t(Chip8::WorkingMemory);
+    if (size > limit) {
+        return false;
+    }
+
+    std::memcpy(memory.data(), Font, sizeof(Font));
+    std::memcpy(memory.data() + BigFontAddress, BigFont, sizeof(BigFont));
+    std::memcpy(memory.data() + StartAddress, rom, size);
+    return true;
+}
+
+void ExtendedChip8::updateTimer()
+{
+    if (delayTimer > 0) { delayTimer -= 1; }
+    if (soundTimer > 0) { soundTimer -= 1; }
+}
+
+std::size_t ExtendedChip8::run(std::size_t steps)
+{
+    std::size_t n = 0;
+    for (; n < steps && !exited; ++n) {
+        step();
+        if (unknown || stackFault) {
+            break;
+        }
+    }
+    return n;
+}
+
+// The base opcodes behave like the Chip8 handlers (see Chip8.cpp) with 16 bit addresses.
+void ExtendedChip8::step()
+{
+    if (exited || unknown || stackFault) {
+        return;
+    }
+
+    const OpCode op = currentOp();
+    const int x   = (op & 0x0F00) >> 8;
+    const int y   = (op & 0x00F0) >> 4;
+    const Byte nn = op & 0x00FF;
+    const Word nnn = op & 0x0FFF;
+    const bool xo = extension == Extension::XoChip;
+
+    PC += 2;
+
+    switch (op & 0xF000) {
+    case 0x0000:
+        if ((op & 0xFFF0) == 0x00C0)       { forPlanes(*this, [&](Plane& p) { scrollDown(*this, p, op & 0x000F); }); return; }
+        if ((op & 0xFFF0) == 0x00D0 && xo) { forPlanes(*this, [&](Plane& p) { scrollUp(*this, p, op & 0x000F); }); return; }
+        switch (op) {
+        case 0x00E0: forPlanes(*this, [](Plane& p) { p.fill({}); }); return;
+        case 0x00EE:
+            if (SI == 0) { PC -= 2; stackFault = true; return; }
+            SI--; PC = stack[SI]; return;
+        case 0x00FB: forPlanes(*this, [&](Plane& p) { scrollRight(*this, p); }); return;
+        case 0x00FC: forPlanes(*this, [&](Plane& p) { scrollLeft(*this, p); }); return;
+        case 0x00FD: exited = true; PC -= 2; return;
+
+        // switching the resolution clears the screen
+        case 0x00FE:
+        case 0x00FF:
+            hires = op == 0x00FF;
+            planes[0].fill({});
+            planes[1].fill({});
+            return;
+        }
+        break;
+
+    case 0x1000: PC = nnn; return;
+    case 0x2000:
+        if (SI >= stack.size()) { PC -= 2; stackFault = true; return; }
+        stack[SI] = PC; SI++; PC = nnn; return;
+    case 0x3000: if (V[x] == nn)   { skipNext(*this); } return;
+    case 0x4000: if (V[x] != nn)   { skipNext(*this); } return;
+    case 0x5000:
+        switch (op & 0x000F) {
+        case 0x0: if (V[x] == V[y]) { skipNext(*this); } return;
+
+        // 5xy2/5xy3  store/load Vx..Vy (in either direction) at I, I is left alone
+        case 0x2:
+        case 0x3:
+            if (!xo) {
+                break;
+            }
+            for (int n = 0, reg = x; ; ++n, reg += x <= y ? 1 : -1) {
+                auto& cell = memory[Word(I + n)];
+                if ((op & 0x000F) == 0x2) { cell = V[reg]; } else { V[reg] = cell; }
+                if (reg == y) {
+                    break;
+                }
+            }
+            return;
+        }
+        break;
+
+    case 0x6000: V[x] = nn; return;
+    case 0x7000: V[x] = Byte(V[x] + nn); return;
+    case 0x8000:
+        switch (op & 0x000F) {
+        case 0x0: V[x] = V[y]; return;
+        case 0x1: V[x] |= V[y]; if (quirks.resetVF) { V[VF] = 0; } return;
+        case 0x2: V[x] &= V[y]; if (quirks.resetVF) { V[VF] = 0; } return;
+        case 0x3: V[x] ^= V[y]; if (quirks.resetVF) { V[VF] = 0; } return;
+        case 0x4: V[VF] = V[x] + V[y] > 255 ? 1 : 0; V[x] += V[y]; return;
+        case 0x5: V[VF] = V[x] > V[y] ? 1 : 0; V[x] -= V[y]; return;
+        case 0x7: V[VF] = V[y] > V[x] ? 1 : 0; V[x] = V[y] - V[x]; return;
+        case 0x6: { const int source = quirks.shiftVy ? y : x; V[VF] = V[source] & 0x1; V[x] = V[source] >> 1; return; }
+        case 0xE: { const int source = quirks.shiftVy ? y : x; V[VF] = V[source] >> 7; V[x] = Byte(V[source] << 1); return; }
+        }
+        break;
+
+    case 0x9000: if (V[x] != V[y]) { skipNext(*this); } return;
+    case 0xA000: I = nnn; return;
+    case 0xB000: PC = nnn + V[quirks.jumpVx ? x : int(V0)]; return;
+    case 0xC000: V[x] = random() & nn; return;
+    case 0xD000: draw(*this, op); return;
+    case 0xE000:
+        if (nn == 0x9E) { if (key[V[x] & 0xF] == Pressed) { skipNext(*this); } return; }
+        if (nn == 0xA1) { if (key[V[x] & 0xF] != Pressed) { skipNext(*this); } return; }
+        break;
+
+    case 0xF000:
+        switch (nn) {
+        // F000 nnnn  I := nnnn
+        case 0x00:
+            if (!xo || x != 0) {
+                break;
+            }
+            I = currentOp();
+            PC += 2;
+            return;
+
+        // Fn01  select the planes n
+        case 0x01:
+            if (!xo) {
+                break;
+            }
+            planeMask = Byte(x & 0x3);
+            return;
+
+        // F002  audio pattern := memory[I..I+15]
+        case 0x02:
+            if (!xo || x != 0) {
+                break;
+            }
+            for (std::size_t n = 0; n < pattern.size(); ++n) {
+                pattern[n] = memory[Word(I + n)];
+            }
+            return;
+
+        case 0x07: V[x] = delayTimer; return;
+        case 0x0A: {
+            bool keyPressed = false;
+            for (std::size_t n = 0; n < key.size(); ++n) {
+                if (key[n] == Pressed) {
+                    V[x] = Byte(n);
+                    keyPressed = true;
+                }
+            }
+            if (!keyPressed) {
+                PC -= 2;
+            }
+            return;
+        }
+        case 0x15: delayTimer = V[x]; return;
+        case 0x18: soundTimer = V[x]; return;
+        case 0x1E: I += V[x]; return;
+        case 0x29: I = (V[x] & 0xF) * 5; return;
+        case 0x30: I = BigFontAddress + (V[x] & 0xF) * 10; return;
+        case 0x33:
+            memory[Word(I + 0)] = V[x] / 100;
+            memory[Word(I + 1)] = (V[x] / 10) % 10;
+            memory[Word(I + 2)] = V[x] % 10;
+            return;
+
+        // Fx3A  pitch := Vx
+        case 0x3A:
+            if (!xo) {
+                break;
+            }
+            pitch = V[x];
+            return;
+
+        case 0x55:
+            for (int reg = V0; reg <= x; ++reg) {
+                memory[Word(I + reg)] = V[reg];
+            }
+            moveIndex(*this, x);
+            return;
+        case 0x65:
+            for (int reg = V0; reg <= x; ++reg) {
+                V[reg] = memory[Word(I + reg)];
+            }
+            moveIndex(*this, x);
+            return;
+
+        // Fx75/Fx85  RPL flags := V0..Vx / V0..Vx := RPL flags
+        case 0x75: std::memcpy(flags.data(), V.data(), x + 1); return;
+        case 0x85: std::memcpy(V.data(), flags.data(), x + 1); return;
+        }
+        break;
+    }
+
+    // not an instruction: like 00FD the machine stays on it, the caller decides what that means
+    PC -= 2;
+    unknown = true;
+}
+
+bool needsExtended(Byte const* rom, std::size_t size, Extension& extension)
+{
+    if (size > Chip8::WorkingMemory) {
+        extension = Extension::XoChip;
+        return true;
+    }
+
+    Chip8 chip;
+    chip.load(rom, size);
+    auto opAt = [&](Word pc) { return OpCode(chip.memory[pc] << 8 | chip.memory[(pc + 1) & 0x0FFF]); };
+
+    // the paths of analyze(), but an extended opcode continues with the next instruction instead of
+    // ending the path: an XO-CHIP opcode behind a SUPER-CHIP one has to be found as well
+    bool any = false;
+    bool xo  = false;
+    std::bitset<4096> seen;
+    std::vector<Word> work = { Chip8::StartAddress };
+    while (!work.empty()) {
+        Word pc = work.back();
+        work.pop_back();
+
+        while (pc + 1 < 4096 && !seen[pc]) {
+            seen.set(pc);
+            const OpCode op = opAt(pc);
+
+            bool xoOnly = false;
+            if (isExtended(op, xoOnly)) {
+                any = true;
+                xo |= xoOnly;
+                if (op == 0x00FD) {
+                    break;
+                }
+                pc += op == 0xF000 ? 4 : 2; // F000 nnnn is four bytes long
+                continue;
+            }
+
+            const Word next = pc + 2;
+            switch (flow(op)) {
+            case Flow::Next:
+            case Flow::Write:
+                pc = next;
+                continue;
+            case Flow::Jump:
+                work.push_back(op & 0x0FFF);
+                break;
+            case Flow::Call:
+                work.push_back(op & 0x0FFF);
+                work.push_back(next);
+                break;
+            case Flow::Skip:
+                // XO-CHIP skips F000 nnnn as a whole
+                work.push_back(next);
+                work.push_back(next + 2);
+                if (next + 1 < 4096 && opAt(next) == 0xF000) {
+                    work.push_back(next + 4);
+                }
+                break;
+            case Flow::Wait:
+                work.push_back(next);
+                break;
+            case Flow::Return:
+            case Flow::Indirect:
+            case Flow::Unknown:
+                break;
+            }
+            break;
+        }
+    }
+
+    extension = xo ? Extension::XoChip : Extension::SuperChip;
+    return any;
+}
+
+bool readFlags(std::string const& path, Bytes<16>& flags)
+{
+    std::ifstream file(path, std::ios::binary);
+    Bytes<16> read = {};
+    if (!file || !file.read(reinterpret_cast<char*>(read.data()), read.size())) {
+        return false;
+    }
+    flags = read;
+    return true;
+}
+
+bool writeFlags(std::string const& path, Bytes<16> const& flags)
+{
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<char const*>(flags.data()), flags.size());
+    return bool(file);
+}
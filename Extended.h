@@ -0,0 +1,135 @@
+#pragma once
+
+#include <array>
+#include <string>
+
+#include "Chip8.h"
+
+// SUPER-CHIP 1.1 and XO-CHIP as a machine of its own: 128x64 hi-res mode, 16x16 sprites (Dxy0),
+// scrolling, the RPL flags, 64 KiB of memory and two bitplanes.
+// Chip8 stays the small 64x32 machine all the fast engines are built for, only roms that need
+// the extensions (see needsExtended) are run here, by a plain switch interpreter.
+
+enum class Extension {
+    SuperChip, // 00Cn, 00FB-00FF, Dxy0, Fx30, Fx75, Fx85
+    XoChip     // SUPER-CHIP plus 00Dn, 5xy2, 5xy3, F000 nnnn, Fn01, F002, Fx3A and 64 KiB of memory
+};
+
+// one line of the 128 pixel wide screen, x == 0 is the highest bit of word 0
+using WideRow = std::array<uint64_t, 2>;
+using Plane   = std::array<WideRow, 64>;
+
+// 8x10 digits 0-F for Fx30, stored right after Font
+const Byte BigFont[] = {
+    0x3C, 0x7E, 0xE7, 0xC3, 0xC3, 0xC3, 0xC3, 0xE7, 0x7E, 0x3C, // 0
+    0x18, 0x38, 0x58, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3C, // 1
+    0x3E, 0x7F, 0xC3, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xFF, 0xFF, // 2
+    0x3C, 0x7E, 0xC3, 0x03, 0x0E, 0x0E, 0x03, 0xC3, 0x7E, 0x3C, // 3
+    0x06, 0x0E, 0x1E, 0x36, 0x66, 0xC6, 0xFF, 0xFF, 0x06, 0x06, // 4
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFE, 0x03, 0xC3, 0x7E, 0x3C, // 5
+    0x3E, 0x7C, 0xC0, 0xC0, 0xFC, 0xFE, 0xC3, 0xC3, 0x7E, 0x3C, // 6
+    0xFF, 0xFF, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x60, 0x60, // 7
+    0x3C, 0x7E, 0xC3, 0xC3, 0x7E, 0x7E, 0xC3, 0xC3, 0x7E, 0x3C, // 8
+    0x3C, 0x7E, 0xC3, 0xC3, 0x7F, 0x3F, 0x03, 0x03, 0x3E, 0x7C, // 9
+    0x3C, 0x7E, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, // A
+    0xFC, 0xFE, 0xC3, 0xC3, 0xFE, 0xFE, 0xC3, 0xC3, 0xFE, 0xFC, // B
+    0x3C, 0x7E, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0x7E, 0x3C, // C
+    0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFC, 0xC0, 0xC0, 0xFF, 0xFF, // E
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFC, 0xC0, 0xC0, 0xC0, 0xC0  // F
+};
+
+// ~66 KB, allocate it on the heap.
+struct ExtendedChip8 {
+
+    const static Word StartAddress = Chip8::StartAddress;
+    const static Word BigFontAddress = sizeof(Font);
+
+    static constexpr std::size_t MemorySize = 0x10000;
+
+    // the lo-res screen uses the first 32 rows and only word 0 of them
+    static constexpr int LoresWidth  = 64;
+    static constexpr int LoresHeight = 32;
+    static constexpr int HiresWidth  = 128;
+    static constexpr int HiresHeight = 64;
+
+    // the quirks of the base opcodes are the ones of 'dialect'
+    explicit ExtendedChip8(Extension extension = Extension::XoChip, Dialect dialect = Dialect::Modern);
+
+    Extension extension;
+    Quirks    quirks;
+
+    // data
+    Bytes<MemorySize> memory = {};
+    Plane             planes[2] = {}; // plane 1 is only drawn on by XO-CHIP
+    Words<16>         stack = {};
+    Bytes<16>         key = {};
+
+    // register
+    Bytes<16> V = {};
+    Word      I = 0;
+    Bytes<16> flags = {};   // RPL user flags (Fx75/Fx85), survive a reset of the machine (see readFlags)
+
+    // indices
+    Byte SI = 0;
+    Word PC = StartAddress;
+
+    // timer
+    Byte delayTimer = 0;
+    Byte soundTimer = 0;
+
+    // XO-CHIP sound: a 1 bit pattern of 128 samples, played at 4000 * 2^((pitch - 64) / 48) Hz
+    Bytes<16> pattern = {};
+    Byte      pitch = 64;
+
+    Byte planeMask = 1;      // planes that are drawn, cleared and scrolled (Fn01)
+    bool hires = false;      // 00FF/00FE
+    bool exited = false;     // 00FD, step() does nothing anymore
+    bool unknown = false;    // PC is on an opcode that doesn't exist, step() does nothing anymore
+    bool stackFault = false; // PC is on a 2nnn with a full stack or a 00EE with an empty one, the same
+
+    uint32_t rng = 0x2545F491;
+
+    // methods
+    void step();
+    std::size_t run(std::size_t steps); // the number of executed instructions, less than 'steps' after 00FD, an unknown opcode or a stack fault
+    void updateTimer();
+    OpCode currentOp() const;
+
+    int width() const  { return hires ? HiresWidth : LoresWidth; }
+    int height() const { return hires ? HiresHeight : LoresHeight; }
+
+    // bit 0 == plane 0, bit 1 == plane 1
+    Byte pixel(int x, int y) const;
+
+    void seed(uint32_t value);
+    Byte random();
+
+    // copies both fonts to 0x000 and the rom to StartAddress; false if the rom doesn't fit
+    // (3.5 KB for SUPER-CHIP, ~64 KB for XO-CHIP)
+    bool load(Byte const* rom, std::size_t size);
+};
+
+// True if the rom uses an opcode of the extended instruction sets or doesn't fit into 4 KB;
+// 'extension' is set to the smallest one that covers it. The opcodes are looked for along the
+// statically known code paths (see Analysis.h), so sprite data that happens to look like Dxy0
+// doesn't count. Roms that are false are run faster by the Chip8 engines.
+bool needsExtended(Byte const* rom, std::size_t size, Extension& extension);
+
+// The RPL flags of a rom as a 16 byte file, the frontend keeps one per rom.
+bool readFlags(std::string const& path, Bytes<16>& flags);
+bool writeFlags(std::string const& path, Bytes<16> const& flags);
+
+inline Byte ExtendedChip8::random()
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return Byte(rng >> 24);
+}
+
+inline Byte ExtendedChip8::pixel(int x, int y) const
+{
+    auto bit = [&](Plane const& p) { return (p[y][x >> 6] >> (63 - (x & 63))) & 1; };
+    return Byte(bit(planes[0]) | bit(planes[1]) << 1);
+}
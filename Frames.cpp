@@ -0,0 +1,241 @@
+// Expands a frame stream (see Capture.h) into pictures, no SDL involved.
+//
+//   chip8-frames [options] stream
+//
+//   --png DIR      one PNG per frame, DIR/frame_000001.png ... (default: the current directory)
+//   --raw FILE     raw rgb24 video instead, all frames in one file; its size is printed for
+//                  "ffmpeg -f rawvideo -pix_fmt rgb24 -s WxH -r 60 -i FILE"
+//   --scale N      size of a chip8 pixel in pixels (default 4)
+//   --changes      only the frames whose screen changed
+//
+// The colors are those of the frontend. In raw video all frames have one size, lo-res frames of a
+// stream that also has hi-res ones are doubled.
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Capture.h"
+
+
+namespace {
+
+    void usage()
+    {
+        std::cout << "usage: chip8-frames [--png DIR] [--raw FILE] [--scale N] [--changes] stream\n";
+    }
+
+    // black, white and the two other colors of XO-CHIP's planes, as in Main.cpp
+    const Byte Palette[4][3] = { { 0x00, 0x00, 0x00 }, { 0xFF, 0xFF, 0xFF }, { 0xAA, 0xAA, 0xAA }, { 0x55, 0x55, 0x55 } };
+
+    uint32_t crc32(Byte const* data, std::size_t size, uint32_t crc = 0)
+    {
+        static const auto table = [] {
+            std::array<uint32_t, 256> t{};
+            for (uint32_t n = 0; n < 256; ++n) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; ++k) {
+                    c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+                }
+                t[n] = c;
+            }
+            return t;
+        }();
+
+        crc = ~crc;
+        for (std::size_t n = 0; n < size; ++n) {
+            crc = table[(crc ^ data[n]) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    void putBig(std::vector<Byte>& out, uint32_t value)
+    {
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            out.push_back(Byte(value >> shift));
+        }
+    }
+
+    void chunk(std::vector<Byte>& png, char const* type, std::vector<Byte> const& data)
+    {
+        putBig(png, uint32_t(data.size()));
+        const std::size_t start = png.size();
+        png.insert(png.end(), type, type + 4);
+        png.insert(png.end(), data.begin(), data.end());
+        putBig(png, crc32(png.data() + start, png.size() - start));
+    }
+
+    // 8 bit palette PNG; the image data is stored, not compressed, so no zlib is needed.
+    // Good enough to look at some frames, long runs are better off as --raw and a video encoder.
+    bool writePng(std::string const& path, std::vector<Byte> const& indices, int width, int height)
+    {
+        std::vector<Byte> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+        std::vector<Byte> header;
+        putBig(header, uint32_t(width));
+        putBig(header, uint32_t(height));
+        header.insert(header.end(), { 8, 3, 0, 0, 0 }); // bit depth 8, palette, deflate, no filter, no interlace
+        chunk(png, "IHDR", header);
+
+        std::vector<Byte> palette;
+        for (auto const& color : Palette) {
+            palette.insert(palette.end(), color, color + 3);
+        }
+        chunk(png, "PLTE", palette);
+
+        // every line starts with filter 0 (none)
+        std::vector<Byte> raw;
+        for (int y = 0; y < height; ++y) {
+            raw.push_back(0);
+            raw.insert(raw.end(), indices.begin() + std::ptrdiff_t(y) * width, indices.begin() + std::ptrdiff_t(y + 1) * width);
+        }
+
+        // zlib stream of stored deflate blocks
+        std::vector<Byte> zlib = { 0x78, 0x01 };
+        for (std::size_t at = 0; at < raw.size() || at == 0; ) {
+            const std::size_t size = std::min<std::size_t>(raw.size() - at, 0xFFFF);
+            const bool last = at + size == raw.size();
+            zlib.insert(zlib.end(), { Byte(last ? 1 : 0), Byte(size), Byte(size >> 8), Byte(~size), Byte(~size >> 8) });
+            zlib.insert(zlib.end(), raw.begin() + std::ptrdiff_t(at), raw.begin() + std::ptrdiff_t(at + size));
+            at += size;
+            if (last) {
+                break;
+            }
+        }
+        uint32_t a = 1, b = 0;
+        for (auto byte : raw) {
+            a = (a + byte) % 65521;
+            b = (b + a) % 65521;
+        }
+        putBig(zlib, b << 16 | a);
+        chunk(png, "IDAT", zlib);
+        chunk(png, "IEND", {});
+
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<char const*>(png.data()), std::streamsize(png.size()));
+        return bool(file);
+    }
+
+    // the palette indices of 'frame', every chip8 pixel 'scale' * 'scale' pixels
+    void render(Frame const& frame, int scale, std::vector<Byte>& indices)
+    {
+        const int width = frame.width * scale;
+        indices.resize(std::size_t(width) * std::size_t(frame.height * scale));
+        for (int y = 0; y < frame.height * scale; ++y) {
+            for (int x = 0; x < width; ++x) {
+                indices[std::size_t(y) * std::size_t(width) + std::size_t(x)] = frame.pixel(x / scale, y / scale);
+            }
+        }
+    }
+
+}
+
+int main(int argc, char** argv)
+{
+    std::string pngDirectory = ".";
+    std::string rawPath;
+    int  scale = 4;
+    bool changes = false;
+
+    std::string streamPath;
+    for (int n = 1; n < argc; ++n) {
+        const std::string arg = argv[n];
+        const bool hasValue = n + 1 < argc;
+
+        if (arg == "--png" && hasValue)        { pngDirectory = argv[++n]; }
+        else if (arg == "--raw" && hasValue)   { rawPath = argv[++n]; }
+        else if (arg == "--scale" && hasValue) { scale = std::max(1, std::atoi(argv[++n])); }
+        else if (arg == "--changes")           { changes = true; }
+        else if (arg.rfind("--", 0) == 0)      { usage(); return EXIT_FAILURE; }
+        else                                   { streamPath = arg; }
+    }
+
+    if (streamPath.empty()) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    FrameDecoder decoder;
+    if (!decoder.open(streamPath)) {
+        std::cout << "Can't read frame stream " << streamPath << '\n';
+        return EXIT_FAILURE;
+    }
+
+    // raw video has one size for all frames: a first pass finds out if there are hi-res frames
+    int rawWidth = Chip8::ScreenWidth * scale;
+    int rawHeight = Chip8::ScreenHeight * scale;
+    std::ofstream raw;
+    if (!rawPath.empty()) {
+        Frame frame;
+        while (decoder.next(frame)) {
+            if (frame.width != Chip8::ScreenWidth) {
+                rawWidth = ExtendedChip8::HiresWidth * scale;
+                rawHeight = ExtendedChip8::HiresHeight * scale;
+            }
+        }
+        decoder.open(streamPath);
+
+        raw.open(rawPath, std::ios::binary | std::ios::trunc);
+        if (!raw) {
+            std::cout << "Can't write " << rawPath << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<Byte> indices;
+    std::vector<Byte> rgb;
+    uint64_t written = 0;
+    bool ok = true;
+
+    auto output = [&](Frame const& frame, uint64_t number) {
+        if (!raw.is_open()) {
+            render(frame, scale, indices);
+            char name[32];
+            std::snprintf(name, sizeof(name), "/frame_%06llu.png", static_cast<unsigned long long>(number));
+            ok = writePng(pngDirectory + name, indices, frame.width * scale, frame.height * scale) && ok;
+        }
+        else {
+            render(frame, rawWidth / frame.width, indices);
+            rgb.clear();
+            for (auto index : indices) {
+                rgb.insert(rgb.end(), Palette[index], Palette[index] + 3);
+            }
+            raw.write(reinterpret_cast<char const*>(rgb.data()), std::streamsize(rgb.size()));
+        }
+        written++;
+    };
+
+    // a record is a changed screen, the frames in between show the previous one again
+    Frame shown;
+    Frame frame;
+    uint64_t number = 1;
+    while (decoder.next(frame)) {
+        for (; !changes && number < frame.number; ++number) {
+            output(shown, number);
+        }
+        output(frame, frame.number);
+        shown = frame;
+        number = frame.number + 1;
+    }
+    for (; !changes && number <= decoder.frames(); ++number) {
+        output(shown, number);
+    }
+
+    if (decoder.damaged()) {
+        std::cout << "Frame stream " << streamPath << " is damaged, stopped after frame " << number - 1 << '\n';
+        ok = false;
+    }
+    if (raw.is_open()) {
+        ok = bool(raw) && ok;
+        std::cout << written << " frames of " << rawWidth << 'x' << rawHeight << " rgb24 written to " << rawPath << '\n';
+    }
+    else {
+        std::cout << written << " frames written to " << pngDirectory << '\n';
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,146 @@
+#include "Frontend.h"
+
+#include <algorithm>
+#include <chrono>
+
+
+int64_t nowNanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void LatencyStats::add(int64_t nanoseconds)
+{
+    min = count == 0 ? nanoseconds : std::min(min, nanoseconds);
+    max = std::max(max, nanoseconds);
+    total += nanoseconds;
+    count++;
+}
+
+void LatencyStats::print(std::ostream& os) const
+{
+    if (count == 0) {
+        os << "input to present: no key change reached the screen\n";
+        return;
+    }
+    os << "input to present: " << count << " changes, min " << min / 1e6 << " ms, avg " << total / 1e6 / count
+       << " ms, max " << max / 1e6 << " ms\n";
+}
+
+Emulation::Emulation(Input& input, AudioStream* audio, unsigned instructionsPerFrame, Dialect dialect)
+    : input(input)
+    , audio(audio)
+    , machine(instructionsPerFrame, dialect)
+{
+}
+
+Emulation::~Emulation()
+{
+    stop();
+}
+
+bool Emulation::load(Byte const* rom, std::size_t size, uint32_t seed)
+{
+    return machine.load(rom, size, seed);
+}
+
+void Emulation::start()
+{
+    if (running.exchange(true)) {
+        return;
+    }
+    thread = std::thread([this] { loop(); });
+}
+
+void Emulation::stop()
+{
+    running = false;
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void Emulation::loop()
+{
+    using Clock = std::chrono::steady_clock;
+    const auto frameDuration = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / Scheduler<Recompiler>::FrameRate));
+
+    auto next = Clock::now();
+    while (running) {
+        runFrame();
+        publish();
+
+        if (audio) {
+            audio->set(machine.sound());
+        }
+
+        // more than a few frames behind (debugger, suspended laptop): don't try to catch up
+        next += frameDuration;
+        const auto now = Clock::now();
+        if (now - next > 4 * frameDuration) {
+            next = now;
+        }
+
+        // wait for the next frame, the audio ring needs a top up every millisecond meanwhile
+        for (auto t = Clock::now(); t < next && running; t = Clock::now()) {
+            if (audio) {
+                audio->pump();
+            }
+            std::this_thread::sleep_for(std::min<Clock::duration>(next - t, std::chrono::milliseconds(1)));
+        }
+        if (audio) {
+            audio->pump();
+        }
+    }
+}
+
+void Emulation::runFrame()
+{
+    const uint16_t mask = input.mask();
+    if (mask != keys) {
+        if (pendingInput == 0) {
+            pendingInput = input.changed();
+        }
+        keys = mask;
+    }
+
+    machine.frame(keys);
+    if (movie) {
+        movie->record(machine, keys);
+    }
+    frameNumber++;
+}
+
+bool Emulation::publish()
+{
+    Frame& frame = published.back();
+    frame.number = frameNumber;
+
+    if (machine.extended()) {
+        auto const& big = machine.extendedChip8();
+        frame.width  = big.width();
+        frame.height = big.height();
+        frame.planes[0] = big.planes[0];
+        frame.planes[1] = big.planes[1];
+    }
+    else {
+        for (int row = 0; row < Chip8::ScreenHeight; ++row) {
+            frame.planes[0][row] = { machine.chip8().screen[row], 0 };
+        }
+    }
+
+    const bool changed = !anyPublished || frame.width != last.width || frame.height != last.height ||
+                         frame.planes[0] != last.planes[0] || frame.planes[1] != last.planes[1];
+    if (!changed) {
+        return false;
+    }
+
+    // a key change that doesn't alter the screen waits for the first frame that does
+    frame.inputTime = pendingInput;
+    pendingInput = 0;
+
+    last = frame;
+    anyPublished = true;
+    published.publish();
+    return true;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <thread>
+
+#include "Chip8.h"
+#include "Extended.h"
+#include "Machine.h"
+#include "Movie.h"
+#include "Sound.h"
+#include "TripleBuffer.h"
+
+// The threads of the frontend, no SDL involved (Main.cpp does the window, the events and the texture):
+//   emulation thread  runs the machine in real time, publishes frames, feeds the audio
+//   main thread       SDL events -> Input, newest Frame -> texture -> window
+// Nothing the main thread does (vsync, a slow scaled present, a moved window) can stall the emulation.
+
+// steady clock in nanoseconds, the time base of all latency stamps
+int64_t nowNanoseconds();
+
+// A completed screen, published by the emulation only when it differs from the previous one (and the first one).
+struct Frame {
+    uint64_t number = 0;      // emulated frame
+    int      width  = Chip8::ScreenWidth;
+    int      height = Chip8::ScreenHeight;
+    Plane    planes[2] = {};  // packed rows as in ExtendedChip8, a Chip8 screen is word 0 of plane 0
+    int64_t  inputTime = 0;   // when the oldest key change that first shows in this frame happened, 0 == none
+
+    Byte pixel(int x, int y) const
+    {
+        auto bit = [&](Plane const& p) { return (p[y][x >> 6] >> (63 - (x & 63))) & 1; };
+        return Byte(bit(planes[0]) | bit(planes[1]) << 1);
+    }
+};
+
+// The keys, written by the input (main) thread, read by the emulation thread once per frame.
+class Input {
+public:
+    void set(int key, bool pressed)
+    {
+        changedAt.store(nowNanoseconds(), std::memory_order_relaxed);
+        const uint16_t bit = uint16_t(1u << (key & 0xF));
+        if (pressed) {
+            keys.fetch_or(bit, std::memory_order_release);
+        }
+        else {
+            keys.fetch_and(uint16_t(~bit), std::memory_order_release);
+        }
+    }
+
+    // one bit per key, bit n == key n
+    uint16_t mask() const { return keys.load(std::memory_order_acquire); }
+
+    // time of the last change, read after mask()
+    int64_t changed() const { return changedAt.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint16_t> keys{ 0 };
+    std::atomic<int64_t>  changedAt{ 0 };
+};
+
+// input to present latencies, main thread only
+struct LatencyStats {
+    uint64_t count = 0;
+    int64_t  total = 0;
+    int64_t  min = 0;
+    int64_t  max = 0;
+
+    void add(int64_t nanoseconds);
+    void print(std::ostream& os) const;
+};
+
+// Runs a rom in real time on its own thread: keys are read at the start of every frame, so a key
+// press reaches key[] within one frame. Between frames the audio is pumped every millisecond.
+// The rom runs on a Machine, optionally recorded into a Movie.
+class Emulation {
+public:
+    Emulation(Input& input, AudioStream* audio, unsigned instructionsPerFrame = 10, Dialect dialect = Dialect::Modern);
+    ~Emulation();
+
+    Emulation(Emulation const&) = delete;
+    Emulation& operator = (Emulation const&) = delete;
+
+    // false if the rom doesn't fit into memory; call before start()
+    bool load(Byte const* rom, std::size_t size, uint32_t seed = 1);
+
+    // every frame from start() to stop() is appended to 'movie' (its header is left to the caller);
+    // call before start(), read 'movie' only after stop()
+    void record(Movie* value) { movie = value; }
+
+    void start();
+    void stop();
+
+    // the newest published frame is read from here by the render side
+    TripleBuffer<Frame>& frames() { return published; }
+
+private:
+    void loop();
+    void runFrame();
+    bool publish(); // false if the screen didn't change
+
+    Input&       input;
+    AudioStream* audio;
+    Machine      machine;
+    Movie*       movie = nullptr;
+
+    uint16_t keys = 0;         // applied to the machine
+    int64_t  pendingInput = 0; // key change that isn't in a published frame yet
+    uint64_t frameNumber = 0;
+
+    TripleBuffer<Frame> published;
+    Frame               last;  // the previously published screen
+    bool                anyPublished = false; // the first screen goes out unchanged as well, the window needs something to show
+
+    std::atomic<bool> running{ false };
+    std::thread       thread;
+};
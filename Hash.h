@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Chip8.h"
+#include "Extended.h"
+
+// FNV-1a, 64 bit. Not cryptographic, only used to compare states and roms.
+const uint64_t HashSeed = 0xCBF29CE484222325;
+
+inline uint64_t hash(void const* data, std::size_t size, uint64_t h = HashSeed)
+{
+    auto bytes = static_cast<Byte const*>(data);
+    for (std::size_t n = 0; n < size; ++n) {
+        h ^= bytes[n];
+        h *= 0x100000001B3;
+    }
+    return h;
+}
+
+// everything a rom can observe or change, the keys and the rng state are left out
+inline uint64_t hash(Chip8 const& c)
+{
+    auto h = hash(c.memory.data(), c.memory.size());
+    h = hash(c.screen.data(), sizeof(c.screen), h);
+    h = hash(c.stack.data(), sizeof(c.stack), h);
+    h = hash(c.V.data(), c.V.size(), h);
+    h = hash(&c.I, sizeof(c.I), h);
+    h = hash(&c.PC, sizeof(c.PC), h);
+    h = hash(&c.SI, sizeof(c.SI), h);
+    h = hash(&c.delayTimer, sizeof(c.delayTimer), h);
+    h = hash(&c.soundTimer, sizeof(c.soundTimer), h);
+    return h;
+}
+
+// the same for the extended machine, plus its screen mode and planes
+inline uint64_t hash(ExtendedChip8 const& c)
+{
+    auto h = hash(c.memory.data(), c.memory.size());
+    h = hash(c.planes, sizeof(c.planes), h);
+    h = hash(c.stack.data(), sizeof(c.stack), h);
+    h = hash(c.V.data(), c.V.size(), h);
+    h = hash(c.flags.data(), c.flags.size(), h);
+    h = hash(&c.I, sizeof(c.I), h);
+    h = hash(&c.PC, sizeof(c.PC), h);
+    h = hash(&c.SI, sizeof(c.SI), h);
+    h = hash(&c.delayTimer, sizeof(c.delayTimer), h);
+    h = hash(&c.soundTimer, sizeof(c.soundTimer), h);
+    h = hash(&c.planeMask, sizeof(c.planeMask), h);
+    h = hash(&c.hires, sizeof(c.hires), h);
+    return h;
+}
+
+// Per frame hash of a running session (see Movie.h): the screen and the registers, chained to the
+// hash of the previous frame. Memory is left out, it's too big to hash every frame; a difference
+// in it shows up in the screen or the registers a few frames later.
+inline uint64_t frameHash(Chip8 const& c, uint64_t previous)
+{
+    auto h = hash(c.screen.data(), sizeof(c.screen), previous);
+    h = hash(c.stack.data(), sizeof(c.stack), h);
+    h = hash(c.V.data(), c.V.size(), h);
+    h = hash(&c.I, sizeof(c.I), h);
+    h = hash(&c.PC, sizeof(c.PC), h);
+    h = hash(&c.SI, sizeof(c.SI), h);
+    h = hash(&c.delayTimer, sizeof(c.delayTimer), h);
+    h = hash(&c.soundTimer, sizeof(c.soundTimer), h);
+    return h;
+}
+
+inline uint64_t frameHash(ExtendedChip8 const& c, uint64_t previous)
+{
+    auto h = hash(c.planes, sizeof(c.planes), previous);
+    h = hash(c.stack.data(), sizeof(c.stack), h);
+    h = hash(c.V.data(), c.V.size(), h);
+    h = hash(&c.I, sizeof(c.I), h);
+    h = hash(&c.PC, sizeof(c.PC), h);
+    h = hash(&c.SI, sizeof(c.SI), h);
+    h = hash(&c.delayTimer, sizeof(c.delayTimer), h);
+    h = hash(&c.soundTimer, sizeof(c.soundTimer), h);
+    h = hash(&c.planeMask, sizeof(c.planeMask), h);
+    h = hash(&c.hires, sizeof(c.hires), h);
+    return h;
+}
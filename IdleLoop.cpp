@@ -0,0 +1,109 @@
+#include "IdleLoop.h"
+
+#include <algorithm>
+
+
+namespace {
+
+    OpCode opAt(Chip8 const& c, int address)
+    {
+        return c.memory[address & 0x0FFF] << 8 | c.memory[(address + 1) & 0x0FFF];
+    }
+
+    bool isJumpTo(OpCode op, int address)
+    {
+        return (op & 0xF000) == 0x1000 && (op & 0x0FFF) == (address & 0x0FFF);
+    }
+
+    bool anyKeyPressed(Chip8 const& c)
+    {
+        return std::any_of(c.key.begin(), c.key.end(), [](Byte k) { return k == Pressed; });
+    }
+
+    // Fx07; 3xkk/4xkk; 1head at 'head', and delayTimer keeps it looping
+    bool isDelayLoop(Chip8 const& c, int head)
+    {
+        const OpCode load = opAt(c, head);
+        const OpCode test = opAt(c, head + 2);
+        if ((load & 0xF0FF) != 0xF007 || !isJumpTo(opAt(c, head + 4), head)) {
+            return false;
+        }
+
+        // the skip has to test the register the timer was loaded into
+        const int x = (load & 0x0F00) >> 8;
+        if ((test & 0x0F00) >> 8 != x) {
+            return false;
+        }
+
+        // 3xkk leaves the loop when Vx == kk, 4xkk when Vx != kk
+        const int kk = test & 0x00FF;
+        switch (test & 0xF000) {
+        case 0x3000: return c.delayTimer != kk;
+        case 0x4000: return c.delayTimer == kk;
+        }
+        return false;
+    }
+
+    // Ex9E/ExA1; 1head at 'head', and the key keeps it looping
+    bool isKeyLoop(Chip8 const& c, int head)
+    {
+        const OpCode test = opAt(c, head);
+        if (!isJumpTo(opAt(c, head + 2), head)) {
+            return false;
+        }
+
+        const bool pressed = c.key[c.V[(test & 0x0F00) >> 8] & 0xF] == Pressed;
+        switch (test & 0xF0FF) {
+        case 0xE09E: return !pressed; // leaves the loop when pressed
+        case 0xE0A1: return pressed;  // leaves the loop when released
+        }
+        return false;
+    }
+
+    IdleLoop loop(Idle kind, int head, int length, int pc)
+    {
+        IdleLoop l;
+        l.kind = kind;
+        l.head = Word(head & 0x0FFF);
+        l.length = Byte(length);
+        l.toHead = Byte(((head + 2 * length - pc) / 2) % length);
+        return l;
+    }
+
+}
+
+IdleLoop findIdleLoop(Chip8 const& c)
+{
+    const int pc = c.PC & 0x0FFF;
+    const OpCode op = opAt(c, pc);
+
+    if (isJumpTo(op, pc)) {
+        return loop(Idle::Halt, pc, 1, pc);
+    }
+    if ((op & 0xF0FF) == 0xF00A && !anyKeyPressed(c)) {
+        return loop(Idle::Key, pc, 1, pc);
+    }
+
+    // PC can be at any instruction of the loop
+    for (int back = 0; back < 3; ++back) {
+        if (isDelayLoop(c, pc - 2 * back)) {
+            return loop(Idle::Delay, pc - 2 * back, 3, pc);
+        }
+    }
+    for (int back = 0; back < 2; ++back) {
+        if (isKeyLoop(c, pc - 2 * back)) {
+            return loop(Idle::Key, pc - 2 * back, 2, pc);
+        }
+    }
+
+    return IdleLoop{};
+}
+
+void skipIterations(Chip8& c, IdleLoop const& loop)
+{
+    if (loop.kind == Idle::Delay) {
+        const int x = c.memory[loop.head] & 0x0F;
+        c.V[x] = c.delayTimer;
+    }
+    c.PC = loop.head;
+}
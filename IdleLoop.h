@@ -0,0 +1,26 @@
+#pragma once
+
+#include "Chip8.h"
+
+// Loops that can't change anything until the next timer tick or key change:
+//   Delay:  Fx07; 3xkk (or 4xkk); 1nnn back to the Fx07   -  waits for delayTimer
+//   Key:    Fx0A without a pressed key                    -  waits for any key
+//           Ex9E/ExA1; 1nnn back to the Ex..              -  waits for one key
+//   Halt:   1nnn jumping to itself                        -  waits forever
+// The timers only change at frame boundaries and the keys only between two Scheduler calls,
+// so whole iterations of such a loop can be skipped without executing them.
+enum class Idle { None, Delay, Key, Halt };
+
+struct IdleLoop {
+    Idle kind   = Idle::None;
+    Word head   = 0; // address of the first instruction of the loop
+    Byte length = 0; // instructions per iteration
+    Byte toHead = 0; // instructions to execute normally until PC reaches 'head'
+};
+
+// checks if PC is inside an idle loop that won't exit with the current timers and keys
+IdleLoop findIdleLoop(Chip8 const& c);
+
+// Puts the machine into the state it has after one or more complete iterations of 'loop'
+// (starting and ending at its head). For a delay loop that's Vx := delayTimer, everything else is unchanged.
+void skipIterations(Chip8& c, IdleLoop const& loop);
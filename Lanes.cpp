@@ -0,0 +1,585 @@
+#include "Lanes.h"
+
+#include <algorithm>
+#include <iostream>
+#include <assert.h>
+
+#if CHIP8_AVX2
+#include <immintrin.h>
+#endif
+
+
+namespace {
+
+#if CHIP8_AVX2
+    using Vec = __m256i;
+
+    Vec  load(Byte const* p)      { return _mm256_loadu_si256(reinterpret_cast<Vec const*>(p)); }
+    void store(Byte* p, Vec v)    { _mm256_storeu_si256(reinterpret_cast<Vec*>(p), v); }
+    Vec  splat(Byte b)            { return _mm256_set1_epi8(char(b)); }
+    Vec  flag(Vec condition)      { return _mm256_and_si256(condition, splat(1)); }        // 0xFF/0x00 -> 1/0
+    Vec  notFlag(Vec condition)   { return _mm256_andnot_si256(condition, splat(1)); }     // 0xFF/0x00 -> 0/1
+#endif
+
+    // dst[lane] := op(a[lane], b[lane]) for every lane in 'mask'.
+    // 'n' is a multiple of 32, dst may be the same array as a or b.
+    template <typename Op>
+    void apply(std::vector<Byte>& dst, std::vector<Byte> const& a, std::vector<Byte> const& b, std::vector<Byte> const& mask, Op op)
+    {
+        const std::size_t n = dst.size();
+        std::size_t i = 0;
+#if CHIP8_AVX2
+        for (; i < n; i += 32) {
+            const Vec result = op(load(&a[i]), load(&b[i]));
+            store(&dst[i], _mm256_blendv_epi8(load(&dst[i]), result, load(&mask[i])));
+        }
+#endif
+        for (; i < n; ++i) {
+            if (mask[i]) {
+                dst[i] = op(a[i], b[i]);
+            }
+        }
+    }
+
+    // PC/I updates of the lanes in 'mask', 16 bit: dst[lane] := value + 2 * add[lane]
+    void setWords(std::vector<Word>& dst, Word value, std::vector<Byte> const& add, std::vector<Byte> const& mask)
+    {
+        const std::size_t n = dst.size();
+        std::size_t i = 0;
+#if CHIP8_AVX2
+        for (; i < n; i += 16) {
+            const __m256i m = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<__m128i const*>(&mask[i])));
+            const __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<__m128i const*>(&add[i])));
+            const __m256i v = _mm256_add_epi16(_mm256_set1_epi16(short(value)), _mm256_add_epi16(a, a));
+            __m256i* p = reinterpret_cast<__m256i*>(&dst[i]);
+            _mm256_storeu_si256(p, _mm256_blendv_epi8(_mm256_loadu_si256(p), v, m));
+        }
+#endif
+        for (; i < n; ++i) {
+            dst[i] = mask[i] ? Word(value + 2 * add[i]) : dst[i];
+        }
+    }
+
+    // dst[lane] := dst[lane] + add[lane] for the lanes in 'mask'
+    void addWords(std::vector<Word>& dst, std::vector<Byte> const& add, std::vector<Byte> const& mask)
+    {
+        const std::size_t n = dst.size();
+        std::size_t i = 0;
+#if CHIP8_AVX2
+        for (; i < n; i += 16) {
+            const __m256i m = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<__m128i const*>(&mask[i])));
+            const __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<__m128i const*>(&add[i])));
+            __m256i* p = reinterpret_cast<__m256i*>(&dst[i]);
+            const __m256i d = _mm256_loadu_si256(p);
+            _mm256_storeu_si256(p, _mm256_blendv_epi8(d, _mm256_add_epi16(d, a), m));
+        }
+#endif
+        for (; i < n; ++i) {
+            dst[i] = mask[i] ? Word(dst[i] + add[i]) : dst[i];
+        }
+    }
+
+    // The lane operations, once for a single lane and once for 32 lanes.
+    // They have to do exactly what the handlers in Chip8.cpp do.
+
+    struct Second {
+        Byte operator () (Byte, Byte b) const { return b; }
+#if CHIP8_AVX2
+        Vec  operator () (Vec, Vec b) const   { return b; }
+#endif
+    };
+
+    struct Constant {
+        Byte value;
+        Byte operator () (Byte, Byte) const { return value; }
+#if CHIP8_AVX2
+        Vec  operator () (Vec, Vec) const   { return splat(value); }
+#endif
+    };
+
+    struct AddConstant {
+        Byte value;
+        Byte operator () (Byte a, Byte) const { return Byte(a + value); }
+#if CHIP8_AVX2
+        Vec  operator () (Vec a, Vec) const   { return _mm256_add_epi8(a, splat(value)); }
+#endif
+    };
+
+    struct Or {
+        Byte operator () (Byte a, Byte b) const { return a | b; }
+#if CHIP8_AVX2
+        Vec  operator () (Vec a, Vec b) const   { return _mm256_or_si256(a, b); }
+#endif
+    };
+
+    struct And {
+        Byte operator () (Byte a, Byte b) const { return a & b; }
+#if CHIP8_AVX2
+        Vec  operator () (Vec a, Vec b) const   { return _mm256_and_si256(a, b); }
+#endif
+    };
+
+    struct Xor {
+        Byte operator () (Byte a, Byte b) const { return a ^ b; }
+#if CHIP8_AVX2
+        Vec  operator () (Vec a, Vec b) const   { return _mm256_xor_si256(a, b); }
+#endif
+    };
+
+    struct Add {
+        Byte operator () (Byte a, Byte b) const { return Byte(a + b); }
+#if CHIP8_AVX2
+        Vec  operator () (Vec a, Vec b) const   { return _mm256_add_epi8(a, b); }
+#endif
+    };
+
+    struct Sub {
+        Byte operator () (Byte a, Byte b) const { return Byte(a - b); }
+#if CHIP8_AVX2
+        Vec  operator () (Vec a, Vec b) const   { return _mm256_sub_epi8(a, b); }
+#endif
+    };
+
+    // 1 if a + b doesn't fit into 8 bit: the saturated sum differs from the wrapped one
+    struct Carry {
+        Byte operator () (Byte a, Byte b) const { return a + b > 255 ? 1 : 0; }
+#if CHIP8_AVX2
+        Vec  operator () (Vec a, Vec b) const   { return notFlag(_mm256_cmpeq_epi8(_mm256_adds_epu8(a, b), _mm256_add_epi8(a, b))); }
+#endif
+    };
+
+    // 1 if a > b: the saturated difference isn't 0
+    struct Greater {
+        Byte operator () (Byte a, Byte b) const { return a > b ? 1 : 0; }
+#if CHIP8_AVX2
+        Vec  operator () (Vec a, Vec b) const   { return notFlag(_mm256_cmpeq_epi8(_mm256_subs_epu8(a, b), _mm256_setzero_si256())); }
+#endif
+    };
+
+    struct HighestBit {
+        Byte operator () (Byte a, Byte) const { return a >> 7; }
+#if CHIP8_AVX2
+        Vec  operator () (Vec a, Vec) const   { return _mm256_and_si256(_mm256_srli_epi16(a, 7), splat(1)); }
+#endif
+    };
+
+    struct LowestBit {
+        Byte operator () (Byte a, Byte) const { return a & 0x1; }
+#if CHIP8_AVX2
+        Vec  operator () (Vec a, Vec) const   { return _mm256_and_si256(a, splat(1)); }
+#endif
+    };
+
+    struct ShiftRight {
+        Byte operator () (Byte a, Byte) const { return a >> 1; }
+#if CHIP8_AVX2
+        Vec  operator () (Vec a, Vec) const   { return _mm256_and_si256(_mm256_srli_epi16(a, 1), splat(0x7F)); }
+#endif
+    };
+
+    struct ShiftLeft {
+        Byte operator () (Byte a, Byte) const { return Byte(a << 1); }
+#if CHIP8_AVX2
+        Vec  operator () (Vec a, Vec) const   { return _mm256_add_epi8(a, a); }
+#endif
+    };
+
+    // 1/0 results, used for the skip conditions
+    struct Equal {
+        Byte operator () (Byte a, Byte b) const { return a == b ? 1 : 0; }
+#if CHIP8_AVX2
+        Vec  operator () (Vec a, Vec b) const   { return flag(_mm256_cmpeq_epi8(a, b)); }
+#endif
+    };
+
+    struct NotEqual {
+        Byte operator () (Byte a, Byte b) const { return a != b ? 1 : 0; }
+#if CHIP8_AVX2
+        Vec  operator () (Vec a, Vec b) const   { return notFlag(_mm256_cmpeq_epi8(a, b)); }
+#endif
+    };
+
+    struct EqualConstant {
+        Byte value;
+        Byte operator () (Byte a, Byte) const { return a == value ? 1 : 0; }
+#if CHIP8_AVX2
+        Vec  operator () (Vec a, Vec) const   { return flag(_mm256_cmpeq_epi8(a, splat(value))); }
+#endif
+    };
+
+    struct NotEqualConstant {
+        Byte value;
+        Byte operator () (Byte a, Byte) const { return a != value ? 1 : 0; }
+#if CHIP8_AVX2
+        Vec  operator () (Vec a, Vec) const   { return notFlag(_mm256_cmpeq_epi8(a, splat(value))); }
+#endif
+    };
+
+    // the V registers an instruction that isn't vectorized may read or write, bit n == Vn;
+    // only those are copied between the lanes and the Chip8 the handler runs on
+    uint16_t registers(Instruction const& in)
+    {
+        const uint16_t x = uint16_t(1 << in.x);
+        const uint16_t y = uint16_t(1 << in.y);
+        const uint16_t f = uint16_t(1 << VF);
+
+        switch (in.op & 0xF000) {
+        case 0x0000:
+        case 0x1000:
+        case 0x2000:
+        case 0xA000: return 0;
+        case 0x3000:
+        case 0x4000:
+        case 0x6000:
+        case 0x7000:
+        case 0xC000:
+        case 0xE000: return x;
+        case 0x5000:
+        case 0x9000: return x | y;
+        case 0x8000:
+        case 0xD000: return x | y | f;
+        case 0xB000: return x | 1;
+        case 0xF000:
+            if ((in.op & 0x00FF) == 0x0055 || (in.op & 0x00FF) == 0x0065) {
+                return uint16_t((2 << in.x) - 1);
+            }
+            return x;
+        }
+        return 0xFFFF;
+    }
+
+    OpCode opAt(Bytes<4096> const& memory, Word pc)
+    {
+        return memory[pc & 0x0FFF] << 8 | memory[(pc + 1) & 0x0FFF];
+    }
+
+    bool sameState(Chip8 const& a, Chip8 const& b)
+    {
+        return a.V == b.V && a.I == b.I && a.PC == b.PC && a.SI == b.SI && a.stack == b.stack
+            && a.delayTimer == b.delayTimer && a.soundTimer == b.soundTimer
+            && a.screen == b.screen && a.memory == b.memory && a.rng == b.rng;
+    }
+
+}
+
+Lanes::Lanes(std::size_t count, Dialect dialect)
+    : count(count)
+    , padded((count + 31) / 32 * 32)
+    , dialect(dialect)
+    , machines(count)
+    , dirty(padded, 0)
+    , mask(padded, 0)
+    , flag(padded, 0)
+    , zero(padded, 0)
+{
+    slot.fill(-1);
+    for (std::size_t lane = 0; lane < count; ++lane) {
+        everyone.push_back(lane);
+    }
+
+    for (auto& reg : V) {
+        reg.assign(padded, 0);
+    }
+    I.assign(padded, 0);
+    PC.assign(padded, Word(Chip8::StartAddress));
+    delayTimer.assign(padded, 0);
+    soundTimer.assign(padded, 0);
+}
+
+void Lanes::set(std::size_t lane, Chip8 const& chip)
+{
+    machines[lane] = chip;
+    for (int reg = V0; reg < VMAX; ++reg) {
+        V[reg][lane] = chip.V[reg];
+    }
+    I[lane] = chip.I;
+    PC[lane] = chip.PC;
+    delayTimer[lane] = chip.delayTimer;
+    soundTimer[lane] = chip.soundTimer;
+
+    // the first machine decides what the common memory looks like
+    if (!hasImage) {
+        image = chip.memory;
+        hasImage = true;
+        for (std::size_t n = 0; n < count; ++n) {
+            dirty[n] = machines[n].memory != image;
+        }
+    }
+    dirty[lane] = chip.memory != image;
+    dirtyLanes = std::size_t(std::count(dirty.begin(), dirty.end(), Byte(1)));
+
+    if (checking) {
+        reference[lane] = chip;
+    }
+}
+
+Chip8 Lanes::get(std::size_t lane) const
+{
+    Chip8 chip = machines[lane];
+    for (int reg = V0; reg < VMAX; ++reg) {
+        chip.V[reg] = V[reg][lane];
+    }
+    chip.I = I[lane];
+    chip.PC = PC[lane];
+    chip.delayTimer = delayTimer[lane];
+    chip.soundTimer = soundTimer[lane];
+    return chip;
+}
+
+void Lanes::run(std::size_t steps)
+{
+    for (std::size_t n = 0; n < steps; ++n) {
+        step();
+    }
+}
+
+void Lanes::verify(bool enabled)
+{
+    checking = enabled;
+    mismatch = false;
+    reference.clear();
+
+    if (enabled) {
+        for (std::size_t lane = 0; lane < count; ++lane) {
+            reference.push_back(get(lane));
+        }
+    }
+}
+
+void Lanes::step()
+{
+    // usually all lanes are at the same instruction: one group, nothing to sort
+    const Word pc = PC[0];
+    Word differ = 0;
+    for (std::size_t lane = 0; lane < count; ++lane) {
+        differ |= Word(PC[lane] ^ pc);
+    }
+
+    if (differ == 0 && dirtyLanes == 0) {
+        if (!maskFull) {
+            std::fill(mask.begin(), mask.begin() + count, Byte(0xFF));
+            maskFull = true;
+        }
+        group(pc, opAt(image, pc), everyone);
+    }
+    else {
+        if (maskFull) {
+            std::fill(mask.begin(), mask.end(), Byte(0));
+            maskFull = false;
+        }
+
+        // one pass over the lanes, by PC. A dirty lane with another opcode than the image runs alone.
+        std::size_t groups = 0;
+        strays.clear();
+        for (std::size_t lane = 0; lane < count; ++lane) {
+            const Word at = PC[lane];
+            if (at > 0x0FFF || (dirty[lane] && opAt(machines[lane].memory, at) != opAt(image, at))) {
+                strays.push_back(lane);
+                continue;
+            }
+            if (slot[at] < 0) {
+                if (groups == members.size()) {
+                    members.emplace_back();
+                    groupPC.push_back(0);
+                }
+                slot[at] = int16_t(groups);
+                groupPC[groups] = at;
+                members[groups++].clear();
+            }
+            members[std::size_t(slot[at])].push_back(lane);
+        }
+
+        for (std::size_t n = 0; n < groups; ++n) {
+            slot[groupPC[n]] = -1;
+            group(groupPC[n], opAt(image, groupPC[n]), members[n]);
+        }
+        for (auto lane : strays) {
+            const Word at = PC[lane];
+            alone.assign(1, lane);
+            group(at, opAt(machines[lane].memory, at), alone);
+        }
+    }
+
+    if (checking) {
+        check();
+    }
+}
+
+void Lanes::updateTimers()
+{
+    for (std::size_t lane = 0; lane < padded; ++lane) {
+        delayTimer[lane] -= delayTimer[lane] > 0 ? 1 : 0;
+        soundTimer[lane] -= soundTimer[lane] > 0 ? 1 : 0;
+    }
+
+    for (auto& ref : reference) {
+        ref.updateTimer();
+    }
+}
+
+void Lanes::group(Word pc, OpCode op, std::vector<std::size_t> const& lanes)
+{
+    const auto in = decode(op, dialect);
+
+    // a masked pass costs the same for one lane as for all, it needs about one lane per vector
+    if (maskFull || lanes.size() * 32 >= padded) {
+        if (!maskFull) {
+            for (auto lane : lanes) {
+                mask[lane] = 0xFF;
+            }
+        }
+        const bool done = vectorized(in, pc);
+        if (!maskFull) {
+            for (auto lane : lanes) {
+                mask[lane] = 0;
+            }
+        }
+        if (done) {
+            return;
+        }
+    }
+    scalar(in, lanes);
+}
+
+bool Lanes::vectorized(Instruction const& in, Word pc)
+{
+    auto& Vx = V[in.x];
+    auto& Vy = V[in.y];
+    auto& Vf = V[VF];
+
+    // 'flag' is 0/1 after a compare, 'zero' adds nothing
+    auto next = [&] {
+        setWords(PC, Word(pc + 2), zero, mask);
+    };
+    auto skipIf = [&] {
+        setWords(PC, Word(pc + 2), flag, mask);
+    };
+
+    switch (in.op & 0xF000) {
+
+    case 0x1000:
+        setWords(PC, in.nnn, zero, mask);
+        return true;
+
+    case 0x3000: apply(flag, Vx, Vx, mask, EqualConstant{ in.nn });    skipIf(); return true;
+    case 0x4000: apply(flag, Vx, Vx, mask, NotEqualConstant{ in.nn }); skipIf(); return true;
+
+    case 0x5000:
+    case 0x9000:
+        if ((in.op & 0x000F) != 0) {
+            return false;
+        }
+        if ((in.op & 0xF000) == 0x5000) {
+            apply(flag, Vx, Vy, mask, Equal{});
+        }
+        else {
+            apply(flag, Vx, Vy, mask, NotEqual{});
+        }
+        skipIf();
+        return true;
+
+    case 0x6000: apply(Vx, Vx, Vx, mask, Constant{ in.nn });    next(); return true;
+    case 0x7000: apply(Vx, Vx, Vx, mask, AddConstant{ in.nn }); next(); return true;
+
+    // Vf is written first, the result is computed from the registers after that (x or y might be F)
+    case 0x8000: {
+        const Quirks q = quirks(dialect);
+        auto& shifted = q.shiftVy ? Vy : Vx;
+
+        switch (in.op & 0x000F) {
+        case 0x0000: apply(Vx, Vx, Vy, mask, Second{}); break;
+        case 0x0001: apply(Vx, Vx, Vy, mask, Or{});     break;
+        case 0x0002: apply(Vx, Vx, Vy, mask, And{});    break;
+        case 0x0003: apply(Vx, Vx, Vy, mask, Xor{});    break;
+        case 0x0004: apply(Vf, Vx, Vy, mask, Carry{});     apply(Vx, Vx, Vy, mask, Add{});        break;
+        case 0x0005: apply(Vf, Vx, Vy, mask, Greater{});   apply(Vx, Vx, Vy, mask, Sub{});        break;
+        case 0x0006: apply(Vf, shifted, shifted, mask, LowestBit{});  apply(Vx, shifted, shifted, mask, ShiftRight{}); break;
+        case 0x0007: apply(Vf, Vy, Vx, mask, Greater{});   apply(Vx, Vy, Vx, mask, Sub{});        break;
+        case 0x000E: apply(Vf, shifted, shifted, mask, HighestBit{}); apply(Vx, shifted, shifted, mask, ShiftLeft{});  break;
+        default:
+            return false;
+        }
+
+        const int op = in.op & 0x000F;
+        if (q.resetVF && op >= 0x1 && op <= 0x3) {
+            apply(Vf, Vf, Vf, mask, Constant{ 0 });
+        }
+        next();
+        return true;
+    }
+
+    case 0xA000:
+        setWords(I, in.nnn, zero, mask);
+        next();
+        return true;
+
+    case 0xF000:
+        switch (in.op & 0x00FF) {
+        case 0x0007: apply(Vx, Vx, delayTimer, mask, Second{}); break;
+        case 0x0015: apply(delayTimer, delayTimer, Vx, mask, Second{}); break;
+        case 0x0018: apply(soundTimer, soundTimer, Vx, mask, Second{}); break;
+        case 0x001E: addWords(I, Vx, mask); break;
+        default:
+            return false;
+        }
+        next();
+        return true;
+    }
+
+    return false;
+}
+
+void Lanes::scalar(Instruction const& in, std::vector<std::size_t> const& lanes)
+{
+    const uint16_t used = registers(in);
+
+    for (auto lane : lanes) {
+        auto& chip = machines[lane];
+        for (int reg = V0; reg < VMAX; ++reg) {
+            if (used & (1 << reg)) {
+                chip.V[reg] = V[reg][lane];
+            }
+        }
+        chip.I = I[lane];
+        chip.PC = PC[lane];
+        chip.delayTimer = delayTimer[lane];
+        chip.soundTimer = soundTimer[lane];
+
+        const Word target = chip.I;
+        chip.execute(in);
+
+        for (int reg = V0; reg < VMAX; ++reg) {
+            if (used & (1 << reg)) {
+                V[reg][lane] = chip.V[reg];
+            }
+        }
+        I[lane] = chip.I;
+        PC[lane] = chip.PC;
+        delayTimer[lane] = chip.delayTimer;
+        soundTimer[lane] = chip.soundTimer;
+
+        for (int addr = target; addr < target + in.writes && !dirty[lane]; ++addr) {
+            if (chip.memory[addr & 0x0FFF] != image[addr & 0x0FFF]) {
+                dirty[lane] = 1;
+                dirtyLanes++;
+            }
+        }
+    }
+}
+
+void Lanes::check()
+{
+    for (std::size_t lane = 0; lane < count; ++lane) {
+        auto& ref = reference[lane];
+        ref.key = machines[lane].key;
+        ref.execute(decode(ref.currentOp(), dialect));
+
+        const Chip8 chip = get(lane);
+        if (!sameState(ref, chip)) {
+            mismatch = true;
+            std::cout << "Lane " << lane << " differs from the interpreter\n";
+            std::cout << "interpreter:\n" << ref << "lanes:\n" << chip;
+            assert(false);
+        }
+    }
+}
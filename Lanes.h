@@ -0,0 +1,97 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "Chip8.h"
+
+#if defined(__AVX2__)
+#define CHIP8_AVX2 1
+#else
+#define CHIP8_AVX2 0
+#endif
+
+// Many machines (usually the same rom with different input) stepped in lockstep.
+// The registers are stored as structure of arrays, V[reg][lane], I[lane], PC[lane]... and one
+// step executes one instruction on every lane: lanes that share PC and opcode form a group,
+// the opcode is decoded once for the group and ALU/register opcodes run on all lanes of the
+// group at once (AVX2, 32 lanes per instruction), masked so other lanes aren't touched.
+// Everything else (draw, call/return, memory...) runs the normal Chip8 handler lane by lane.
+//
+// While all lanes are at the same PC (the usual case) there is one group and nothing to sort.
+// Otherwise the lanes are put into groups by PC in one pass; a masked pass costs the same for one
+// lane as for all of them, so small groups run lane by lane instead.
+// Only worth it for register heavy code: on alu (chip8-bench) 64 lanes together execute several
+// times the instructions per second of a single interpreter, on draw, call and memory fewer.
+class Lanes {
+public:
+    explicit Lanes(std::size_t count, Dialect dialect = Dialect::Modern);
+
+    std::size_t size() const { return count; }
+
+    // conversion from/to single machines
+    void  set(std::size_t lane, Chip8 const& chip);
+    Chip8 get(std::size_t lane) const;
+
+    // key state of a lane, can be changed between steps
+    Bytes<16>& key(std::size_t lane) { return machines[lane].key; }
+
+    // executes one instruction on every lane
+    void step();
+    void run(std::size_t steps);
+
+    // the 60 Hz timer tick of every lane
+    void updateTimers();
+
+    // Correctness mode: every lane is also run on a plain Chip8 with Chip8::emulate
+    // and compared after every step. Slow, meant for tests of this class.
+    void verify(bool enabled);
+    bool diverged() const { return mismatch; }
+
+private:
+    void group(Word pc, OpCode op, std::vector<std::size_t> const& lanes);
+    bool vectorized(Instruction const& in, Word pc);
+    void scalar(Instruction const& in, std::vector<std::size_t> const& lanes);
+    void check();
+
+    std::size_t count;  // real lanes
+    std::size_t padded; // count rounded up to a multiple of 32, the padding lanes are never active
+    Dialect     dialect;
+
+    // hot registers, structure of arrays
+    std::array<std::vector<Byte>, 16> V;
+    std::vector<Word> I;
+    std::vector<Word> PC;
+    std::vector<Byte> delayTimer;
+    std::vector<Byte> soundTimer;
+
+    // The rest of every lane (memory, screen, stack, keys, rng) stays in a normal Chip8.
+    // Its V/I/PC/timer fields are only up to date while a scalar handler runs on it.
+    std::vector<Chip8> machines;
+
+    // Memory all lanes started with; lanes whose memory differs from it (dirty) have their
+    // opcode checked one by one, for all others the opcode of the image is the right one.
+    Bytes<4096>       image = {};
+    bool              hasImage = false;
+    std::vector<Byte> dirty;
+    std::size_t       dirtyLanes = 0;
+
+    // per step scratch: 0xFF == lane is in the group that is executed
+    std::vector<Byte> mask;
+    bool              maskFull = false; // every real lane is set
+    std::vector<Byte> flag;
+    std::vector<Byte> zero;
+
+    // the groups of a step that isn't in lockstep, by PC
+    std::array<int16_t, 4096>             slot;    // group of a PC, -1 == none yet
+    std::vector<Word>                     groupPC;
+    std::vector<std::vector<std::size_t>> members;
+    std::vector<std::size_t>              strays;  // lanes with their own opcode at PC, run alone
+    std::vector<std::size_t>              alone;
+    std::vector<std::size_t>              everyone;
+
+    bool               checking = false;
+    bool               mismatch = false;
+    std::vector<Chip8> reference;
+};
@@ -0,0 +1,62 @@
+#include "Machine.h"
+
+#include <algorithm>
+
+#include "Hash.h"
+
+
+Machine::Machine(unsigned instructionsPerFrame, Dialect dialect)
+    : instructionsPerFrame(std::max(1u, instructionsPerFrame))
+    , dialect(dialect)
+{
+}
+
+bool Machine::load(Byte const* rom, std::size_t size, uint32_t seed)
+{
+    frameCount = 0;
+
+    Extension extension = Extension::SuperChip;
+    isExtended = needsExtended(rom, size, extension);
+    if (isExtended) {
+        big = std::make_unique<ExtendedChip8>(extension, dialect);
+        big->seed(seed);
+        return big->load(rom, size);
+    }
+
+    chip = Chip8{};
+    chip.seed(seed);
+    if (!chip.load(rom, size)) {
+        return false;
+    }
+    engine = std::make_unique<Recompiler>(chip, Engine::Interpreter, dialect, OnUnknown::Halt);
+    scheduler = std::make_unique<Scheduler<Recompiler>>(chip, *engine, instructionsPerFrame);
+    scheduler->setPacing(Pacing::Turbo); // the caller paces, if at all
+    return true;
+}
+
+void Machine::frame(uint16_t keys)
+{
+    auto& key = isExtended ? big->key : chip.key;
+    for (int n = 0; n < 16; ++n) {
+        key[n] = (keys >> n) & 1 ? Pressed : 0;
+    }
+
+    if (isExtended) {
+        big->run(instructionsPerFrame);
+        big->updateTimer();
+    }
+    else {
+        scheduler->runFrame();
+    }
+    frameCount++;
+}
+
+uint64_t Machine::hash(uint64_t previous) const
+{
+    return isExtended ? frameHash(*big, previous) : frameHash(chip, previous);
+}
+
+Sound Machine::sound() const
+{
+    return isExtended ? ::sound(*big) : ::sound(chip);
+}
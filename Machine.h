@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "Chip8.h"
+#include "Extended.h"
+#include "Recompiler.h"
+#include "Scheduler.h"
+#include "Sound.h"
+
+// One rom, run frame by frame with the keys given per frame: on the interpreter (with the idle loop
+// skipping of the Scheduler) or, for roms that need SUPER-CHIP/XO-CHIP, on ExtendedChip8.
+// Not on the Recompiler, it isn't faster on every rom (see chip8-bench).
+// The frontend and the movie replay (Movie.h) both run roms through this, so a replay executes
+// exactly what was recorded, only without waiting for the next frame.
+// A rom that reaches an unknown opcode stops there, neither machine asserts.
+class Machine {
+public:
+    Machine(unsigned instructionsPerFrame = 10, Dialect dialect = Dialect::Modern);
+
+    Machine(Machine const&) = delete;
+    Machine& operator = (Machine const&) = delete;
+
+    // false if the rom doesn't fit into memory; 'seed' is the seed of Cxnn
+    bool load(Byte const* rom, std::size_t size, uint32_t seed = 1);
+
+    // the keys (bit n == key n) are down during the whole frame
+    void frame(uint16_t keys);
+
+    // frameHash (Hash.h) of the current state, chained to 'previous'
+    uint64_t hash(uint64_t previous) const;
+
+    Word  pc() const { return isExtended ? big->PC : chip.PC; }
+    Sound sound() const;
+
+    bool extended() const { return isExtended; }
+    Chip8 const& chip8() const { return chip; }
+    ExtendedChip8 const& extendedChip8() const { return *big; } // only if extended()
+
+    uint64_t frames() const { return frameCount; }
+    unsigned cyclesPerFrame() const { return instructionsPerFrame; }
+
+private:
+    unsigned instructionsPerFrame;
+    Dialect  dialect;
+
+    // only one of the machines is used, 'isExtended' tells which
+    bool                                   isExtended = false;
+    Chip8                                  chip;
+    std::unique_ptr<Recompiler>            engine;
+    std::unique_ptr<Scheduler<Recompiler>> scheduler;
+    std::unique_ptr<ExtendedChip8>         big;
+
+    uint64_t frameCount = 0;
+};
@@ -1,9 +1,10 @@
 #include <iostream>
-#include <iomanip> // for std::setfill, std::setw...
 #include <assert.h>
-#include <fstream>
 
 #include "Chip8.h"
+#include "Frontend.h"
+#include "RomLibrary.h"
+#include "SdlAudio.h"
 
 // sdl2 is used for graphics
 #include "sdl2/SDL.h"
@@ -12,52 +13,59 @@
 #define SDL_FAILURE(msg) std::cout << "SDL: " << msg << " ; error ==" << SDL_GetError() << '\n';
 
 
+// Chip8 [rom] [--record movie]   (the rom defaults to PONG.rom; a movie is replayed by chip8-replay)
 int main(int argc, char** argv)
 {
-    // check if the file fits into the chip8 memory
-    std::ifstream file("PONG.rom", std::ios::binary | std::ios::ate);
-    auto fileSize = file.tellg();
-    if (fileSize > Chip8::WorkingMemory) {
-        assert(false);
-        std::cout << "File too big! Expected " << Chip8::WorkingMemory << " bytes, got " << fileSize << " instead.\n";
-        return EXIT_FAILURE;
+    std::string romPath = "PONG.rom";
+    std::string moviePath;
+    for (int n = 1; n < argc; ++n) {
+        const std::string arg = argv[n];
+        if (arg == "--record" && n + 1 < argc) {
+            moviePath = argv[++n];
+        }
+        else {
+            romPath = arg;
+        }
     }
 
-    // rewind to the beginning
-    file.seekg(0, file.beg);
-
-    // memory test
-    {
-        std::array<char, Chip8::WorkingMemory> buffer{};
-        file.read(buffer.data(), buffer.size());
-
-        Chip8 chip;
-        std::memcpy(chip.memory.data() + Chip8::StartAddress, buffer.data(), buffer.size());
+    // the rom is mapped, not read; the index knows its title, dialect and which machine it needs
+    RomLibrary library;
+    if (!library.addFile(romPath)) {
+        std::cout << "Can't read rom " << romPath << '\n';
+        return EXIT_FAILURE;
+    }
+    Rom const& rom = library.roms().front();
 
-        std::cout << std::hex;
-        for (std::size_t n = 0; n < chip.memory.size(); ++n) {
-            std::cout << "0x" << std::setfill('0') << std::setw(4);;
-            std::cout << chip.memory[n] << '\n';
-        }
-        std::cout << std::dec;
+    DialectDatabase dialects;
+    dialects.load("dialects.txt"); // optional
+    RomIndex index;
+    index.load("roms.idx");
+    RomMeta const meta = index.lookup(rom, &dialects);
+    if (index.modified()) {
+        index.save("roms.idx");
     }
 
-    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0) {
         SDL_FAILURE("Init system");
         return EXIT_FAILURE;
     }
 
-    auto screenWidth = Chip8::ScreenWidth * 100;
-    auto screenHeight = Chip8::ScreenHeight * 100;
+    // no sound device is no reason to stop, the emulation runs without sound then
+    AudioStream audioStream;
+    SdlAudio audio(audioStream);
+    audio.open();
 
-    /// TODO replace title with the game title!
-    auto window = SDL_CreateWindow("Chip8 Emulator", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, screenWidth, screenHeight, SDL_WINDOW_SHOWN);
+    auto screenWidth = Chip8::ScreenWidth * 10;
+    auto screenHeight = Chip8::ScreenHeight * 10;
+
+    const std::string title = "Chip8 Emulator - " + meta.title;
+    auto window = SDL_CreateWindow(title.c_str(), SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, screenWidth, screenHeight, SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);
     if (!window) {
         SDL_FAILURE("Init window");
         return EXIT_FAILURE;
     }
 
-    auto renderer = SDL_CreateRenderer(window, -1, 0);
+    auto renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_PRESENTVSYNC);
     if (!renderer) {
         SDL_FAILURE("Init renderer");
         return EXIT_FAILURE;
@@ -80,5 +88,126 @@ int main(int argc, char** argv)
         std::cout << chip << '\n';
     }
 
+    // the emulation runs on its own thread from here on, this one only handles events and presents
+    Input input;
+    Emulation emulation(input, &audioStream, 10, meta.dialect);
+
+    // Cxnn differs from run to run, a recording keeps the seed in the movie
+    Movie movie;
+    movie.romHash = rom.hash;
+    movie.dialect = meta.dialect;
+    movie.instructionsPerFrame = 10;
+    movie.seed = uint32_t(nowNanoseconds());
+    if (!emulation.load(rom.data, rom.size, movie.seed)) {
+        std::cout << "Rom " << romPath << " is too big, " << rom.size << " bytes\n";
+        return EXIT_FAILURE;
+    }
+    if (!moviePath.empty()) {
+        emulation.record(&movie);
+    }
+    emulation.start();
+
+    // keys 1234/QWER/ASDF/ZXCV are the hex pad 123C/456D/789E/A0BF
+    const SDL_Keycode Keypad[16] = {
+        SDLK_x, SDLK_1, SDLK_2, SDLK_3,
+        SDLK_q, SDLK_w, SDLK_e, SDLK_a,
+        SDLK_s, SDLK_d, SDLK_z, SDLK_c,
+        SDLK_4, SDLK_r, SDLK_f, SDLK_v
+    };
+
+    // black, white and the two other colors of XO-CHIP's planes
+    const Uint32 Palette[4] = { 0xFF000000, 0xFFFFFFFF, 0xFFAAAAAA, 0xFF555555 };
+
+    SDL_Texture* texture = nullptr;
+    int textureWidth = 0;
+    int textureHeight = 0;
+
+    LatencyStats latency;
+    bool quit = false;
+    bool redraw = false; // the window lost its content (uncovered, resized), the front frame is presented again
+    while (!quit) {
+        SDL_Event event;
+        while (SDL_PollEvent(&event)) {
+            if (event.type == SDL_QUIT) {
+                quit = true;
+            }
+            if (event.type == SDL_WINDOWEVENT &&
+                (event.window.event == SDL_WINDOWEVENT_EXPOSED || event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)) {
+                redraw = true;
+            }
+            if ((event.type == SDL_KEYDOWN || event.type == SDL_KEYUP) && !event.key.repeat) {
+                for (int key = 0; key < 16; ++key) {
+                    if (event.key.keysym.sym == Keypad[key]) {
+                        input.set(key, event.type == SDL_KEYDOWN);
+                    }
+                }
+            }
+        }
+
+        // only a changed screen is published, so only a changed screen is uploaded; the texture
+        // still has the front frame for a redraw
+        const bool fresh = emulation.frames().update();
+        if (!fresh && !(redraw && texture)) {
+            SDL_Delay(1);
+            continue;
+        }
+        redraw = false;
+        Frame const& frame = emulation.frames().front();
+
+        if (fresh && (!texture || textureWidth != frame.width || textureHeight != frame.height)) {
+            if (texture) {
+                SDL_DestroyTexture(texture);
+            }
+            texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, frame.width, frame.height);
+            if (!texture) {
+                SDL_FAILURE("Create texture");
+                break;
+            }
+            textureWidth = frame.width;
+            textureHeight = frame.height;
+        }
+
+        void* pixels = nullptr;
+        int pitch = 0;
+        if (fresh && SDL_LockTexture(texture, nullptr, &pixels, &pitch) == 0) {
+            for (int y = 0; y < frame.height; ++y) {
+                auto line = reinterpret_cast<Uint32*>(static_cast<Uint8*>(pixels) + y * pitch);
+                for (int x = 0; x < frame.width; ++x) {
+                    line[x] = Palette[frame.pixel(x, y)];
+                }
+            }
+            SDL_UnlockTexture(texture);
+        }
+
+        // scaled to the window by the gpu
+        SDL_RenderClear(renderer);
+        SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+        SDL_RenderPresent(renderer);
+
+        if (fresh && frame.inputTime != 0) {
+            latency.add(nowNanoseconds() - frame.inputTime);
+        }
+    }
+
+    emulation.stop();
+    audio.close();
+
+    if (!moviePath.empty()) {
+        if (saveMovie(moviePath, movie)) {
+            std::cout << movie.keys.size() << " frames recorded to " << moviePath << '\n';
+        }
+        else {
+            std::cout << "Can't write movie " << moviePath << '\n';
+        }
+    }
+    latency.print(std::cout);
+
+    if (texture) {
+        SDL_DestroyTexture(texture);
+    }
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+
     return EXIT_SUCCESS;
 }
\ No newline at end of file
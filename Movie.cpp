@@ -0,0 +1,163 @@
+#include "Movie.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "Hash.h"
+
+
+namespace {
+
+    const char MovieMagic[4] = { 'C', '8', 'M', 'V' };
+    constexpr std::size_t HeaderSize = 36;
+    constexpr std::size_t RunSize = 6;
+
+    template <typename T>
+    void put(std::vector<Byte>& out, T value)
+    {
+        for (std::size_t n = 0; n < sizeof(T); ++n) {
+            out.push_back(Byte(value >> (8 * n)));
+        }
+    }
+
+    template <typename T>
+    T get(Byte const* in)
+    {
+        T value = 0;
+        for (std::size_t n = 0; n < sizeof(T); ++n) {
+            value |= T(T(in[n]) << (8 * n));
+        }
+        return value;
+    }
+
+}
+
+void Movie::record(Machine const& machine, uint16_t frameKeys)
+{
+    keys.push_back(frameKeys);
+    hashes.push_back(machine.hash(hashes.empty() ? HashSeed : hashes.back()));
+}
+
+bool loadMovie(std::string const& path, Movie& movie)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    const std::vector<Byte> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    if (data.size() < HeaderSize || std::memcmp(data.data(), MovieMagic, sizeof(MovieMagic)) != 0 ||
+        get<uint32_t>(data.data() + 4) != MovieVersion || data[16] > Byte(Dialect::Modern)) {
+        return false;
+    }
+
+    Movie parsed;
+    parsed.romHash = get<uint64_t>(data.data() + 8);
+    parsed.dialect = Dialect(data[16]);
+    parsed.instructionsPerFrame = get<uint32_t>(data.data() + 20);
+    parsed.seed = get<uint32_t>(data.data() + 24);
+    const std::size_t frames = get<uint32_t>(data.data() + 28);
+    const std::size_t runs = get<uint32_t>(data.data() + 32);
+    const bool hashed = data[17] != 0;
+
+    // checked up front, so a damaged count doesn't allocate gigabytes
+    if (runs > (data.size() - HeaderSize) / RunSize ||
+        data.size() != HeaderSize + runs * RunSize + (hashed ? frames * sizeof(uint64_t) : 0)) {
+        return false;
+    }
+
+    parsed.keys.reserve(frames);
+    for (std::size_t n = 0; n < runs; ++n) {
+        Byte const* run = data.data() + HeaderSize + n * RunSize;
+        const std::size_t length = get<uint32_t>(run);
+        if (length > frames - parsed.keys.size()) {
+            return false;
+        }
+        parsed.keys.insert(parsed.keys.end(), length, get<uint16_t>(run + 4));
+    }
+    if (parsed.keys.size() != frames) {
+        return false;
+    }
+
+    if (hashed) {
+        Byte const* hashes = data.data() + HeaderSize + runs * RunSize;
+        parsed.hashes.resize(frames);
+        for (std::size_t n = 0; n < frames; ++n) {
+            parsed.hashes[n] = get<uint64_t>(hashes + n * sizeof(uint64_t));
+        }
+    }
+
+    movie = std::move(parsed);
+    return true;
+}
+
+bool saveMovie(std::string const& path, Movie const& movie)
+{
+    if (!movie.hashes.empty() && movie.hashes.size() != movie.keys.size()) {
+        return false;
+    }
+
+    // runs of frames with the same keys
+    std::vector<Byte> runs;
+    uint32_t count = 0;
+    for (std::size_t start = 0; start < movie.keys.size(); ) {
+        std::size_t end = start + 1;
+        while (end < movie.keys.size() && movie.keys[end] == movie.keys[start] && end - start < UINT32_MAX) {
+            ++end;
+        }
+        put(runs, uint32_t(end - start));
+        put(runs, movie.keys[start]);
+        count++;
+        start = end;
+    }
+
+    std::vector<Byte> out(MovieMagic, MovieMagic + sizeof(MovieMagic));
+    put(out, MovieVersion);
+    put(out, movie.romHash);
+    out.push_back(Byte(movie.dialect));
+    out.push_back(Byte(movie.hashes.empty() ? 0 : 1));
+    put(out, uint16_t(0));
+    put(out, uint32_t(movie.instructionsPerFrame));
+    put(out, movie.seed);
+    put(out, uint32_t(movie.keys.size()));
+    put(out, count);
+    out.insert(out.end(), runs.begin(), runs.end());
+    for (auto h : movie.hashes) {
+        put(out, h);
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<char const*>(out.data()), std::streamsize(out.size()));
+    return bool(file);
+}
+
+ReplayResult replay(Movie const& movie, Byte const* rom, std::size_t size)
+{
+    ReplayResult result;
+
+    Machine machine(movie.instructionsPerFrame, movie.dialect);
+    if (!machine.load(rom, size, movie.seed)) {
+        result.loaded = false;
+        return result;
+    }
+
+    result.hashes.reserve(movie.keys.size());
+    uint64_t h = HashSeed;
+    for (std::size_t n = 0; n < movie.keys.size(); ++n) {
+        machine.frame(movie.keys[n]);
+        h = machine.hash(h);
+        result.hashes.push_back(h);
+        result.frames++;
+
+        if (!movie.hashes.empty() && movie.hashes[n] != h) {
+            result.diverged = true;
+            result.frame = n;
+            result.pc = machine.pc();
+            result.expected = movie.hashes[n];
+            result.actual = h;
+            break;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Chip8.h"
+#include "Machine.h"
+
+// A recorded session: the keys of every frame plus everything else a run depends on (rom, dialect,
+// speed, seed of Cxnn). Played back on a Machine it runs exactly as recorded, as fast as the host can.
+// The hash stream is the frameHash after every frame, recorded with the movie; a replay compares
+// against it and stops at the first frame that differs.
+struct Movie {
+    uint64_t romHash = 0;                 // see RomLibrary, Rom::hash
+    Dialect  dialect = Dialect::Modern;
+    unsigned instructionsPerFrame = 10;
+    uint32_t seed = 1;
+
+    std::vector<uint16_t> keys;   // per frame, bit n == key n
+    std::vector<uint64_t> hashes; // per frame, empty == no reference
+
+    // recording: call after every Machine::frame() with the keys of that frame
+    void record(Machine const& machine, uint16_t frameKeys);
+};
+
+// File: "C8MV" magic, u32 version (MovieVersion), u64 rom hash, u8 dialect, u8 has hashes, u16 0,
+// u32 instructions per frame, u32 seed, u32 frames, u32 key runs,
+// key runs * { u32 frames, u16 keys } (the keys rarely change), then frames * u64 hash if it has hashes.
+// All numbers little endian.
+const uint32_t MovieVersion = 1;
+
+// false (and 'movie' is untouched) if the file can't be read, has another version or is damaged
+bool loadMovie(std::string const& path, Movie& movie);
+bool saveMovie(std::string const& path, Movie const& movie);
+
+struct ReplayResult {
+    bool     loaded   = true;   // false: the rom doesn't fit into memory, nothing was run
+    uint64_t frames   = 0;      // replayed frames, up to and including the differing one
+    bool     diverged = false;
+    uint64_t frame    = 0;      // the first differing frame (0 based), if diverged
+    Word     pc       = 0;      // PC after that frame
+    uint64_t expected = 0;      // hashes of that frame
+    uint64_t actual   = 0;
+    std::vector<uint64_t> hashes; // the replayed hash stream
+};
+
+// Replays 'movie' headless and unthrottled on 'rom'. Stops at the first frame whose hash differs from
+// the movie's hashes, a movie without hashes is replayed to the end.
+ReplayResult replay(Movie const& movie, Byte const* rom, std::size_t size);
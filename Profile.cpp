@@ -0,0 +1,85 @@
+#include "Profile.h"
+
+#include <algorithm>
+#include <iomanip>
+
+
+void Profile::block(Chip8 const& c, Word pc, Word count)
+{
+    instructions += count;
+    for (Word n = 0; n < count; ++n) {
+        const Word address = (pc + 2 * n) & 0x0FFF;
+        classes[c.memory[address] >> 4]++;
+        hits[address]++;
+    }
+}
+
+void Profile::frame(uint64_t nanoseconds)
+{
+    frames++;
+    frameNanoseconds += nanoseconds;
+    maxFrameNanoseconds = std::max(maxFrameNanoseconds, nanoseconds);
+}
+
+void Profile::summary(std::ostream& os) const
+{
+    const double drawShare = instructions ? 100.0 * draws / instructions : 0.0;
+    const double averageFrame = frames ? double(frameNanoseconds) / frames : 0.0;
+
+    os << instructions << " instructions, " << frames << " frames, "
+       << draws << " draws (" << std::fixed << std::setprecision(1) << drawShare << "%), "
+       << collisions << " collisions, stack " << int(stackHighWater) << ", "
+       << std::setprecision(0) << averageFrame << " ns/frame avg, " << maxFrameNanoseconds << " ns max\n";
+    os << std::defaultfloat << std::setprecision(6);
+}
+
+void Profile::writeJson(std::ostream& os) const
+{
+    os << "{\n";
+    os << "  \"instructions\": " << instructions << ",\n";
+    os << "  \"draws\": " << draws << ",\n";
+    os << "  \"collisions\": " << collisions << ",\n";
+    os << "  \"stackHighWater\": " << int(stackHighWater) << ",\n";
+    os << "  \"frames\": " << frames << ",\n";
+    os << "  \"frameNanoseconds\": " << frameNanoseconds << ",\n";
+    os << "  \"maxFrameNanoseconds\": " << maxFrameNanoseconds << ",\n";
+
+    os << "  \"classes\": {";
+    for (std::size_t n = 0; n < classes.size(); ++n) {
+        os << (n ? ", " : "") << '"' << std::hex << std::uppercase << n << std::dec << "\": " << classes[n];
+    }
+    os << "},\n";
+
+    os << "  \"hits\": {";
+    bool first = true;
+    for (std::size_t n = 0; n < hits.size(); ++n) {
+        if (hits[n]) {
+            os << (first ? "" : ", ") << "\"0x" << std::hex << std::setfill('0') << std::setw(3) << n << std::dec << "\": " << hits[n];
+            first = false;
+        }
+    }
+    os << "}\n}\n";
+    os << std::nouppercase << std::setfill(' ');
+}
+
+void Profile::writeCsv(std::ostream& os) const
+{
+    os << "kind,key,count\n";
+    os << "counter,instructions," << instructions << '\n';
+    os << "counter,draws," << draws << '\n';
+    os << "counter,collisions," << collisions << '\n';
+    os << "counter,stackHighWater," << int(stackHighWater) << '\n';
+    os << "counter,frames," << frames << '\n';
+    os << "counter,frameNanoseconds," << frameNanoseconds << '\n';
+    os << "counter,maxFrameNanoseconds," << maxFrameNanoseconds << '\n';
+
+    for (std::size_t n = 0; n < classes.size(); ++n) {
+        os << "class," << std::hex << std::uppercase << n << std::dec << ',' << classes[n] << '\n';
+    }
+    for (std::size_t n = 0; n < hits.size(); ++n) {
+        if (hits[n]) {
+            os << "pc,0x" << std::hex << std::setfill('0') << std::setw(3) << n << std::dec << ',' << hits[n] << '\n';
+        }
+    }
+    os << std::nouppercase << std::setfill(' ');
+}
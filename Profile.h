@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+
+#include "Chip8.h"
+
+// Opt-in instrumentation, build with CHIP8_PROFILE=1 to get it. Without it the engines and the
+// Scheduler don't know about Profile at all, the hot paths stay exactly as they are.
+#ifndef CHIP8_PROFILE
+#define CHIP8_PROFILE 0
+#endif
+
+// What a rom spends its time on. Attach one to DecodeCache/Recompiler (instructions) and
+// Scheduler (frames) with their setProfile(). Not thread safe, one per instance.
+struct Profile {
+    std::array<uint64_t, 16>   classes = {}; // executed instructions per opcode class (highest nibble)
+    std::array<uint64_t, 4096> hits    = {}; // executed instructions per address
+
+    uint64_t instructions   = 0;
+    uint64_t draws          = 0; // Dxyn
+    uint64_t collisions     = 0; // Dxyn that set VF
+    Byte     stackHighWater = 0; // deepest SI seen
+
+    uint64_t frames         = 0;
+    uint64_t frameNanoseconds    = 0; // host time spent emulating, summed over all frames
+    uint64_t maxFrameNanoseconds = 0;
+
+    // one interpreted instruction, called after it was executed; 'pc' is where it started
+    void instruction(Chip8 const& c, Word pc, OpCode op);
+
+    // 'count' translated instructions starting at 'pc', they never draw or touch the stack
+    void block(Chip8 const& c, Word pc, Word count);
+
+    void frame(uint64_t nanoseconds);
+
+    void reset() { *this = Profile{}; }
+
+    // one line: totals, draw share, stack depth, frame times
+    void summary(std::ostream& os) const;
+
+    // everything, the hits only for addresses that were executed
+    void writeJson(std::ostream& os) const;
+    void writeCsv(std::ostream& os) const; // "kind,key,count" lines
+};
+
+inline void Profile::instruction(Chip8 const& c, Word pc, OpCode op)
+{
+    instructions++;
+    classes[op >> 12]++;
+    hits[pc & 0x0FFF]++;
+
+    if ((op & 0xF000) == 0xD000) {
+        draws++;
+        collisions += c.V[VF];
+    }
+    if (c.SI > stackHighWater) {
+        stackHighWater = c.SI;
+    }
+}
@@ -0,0 +1,431 @@
+#include "Recompiler.h"
+
+#include <algorithm>
+#include <cstddef> // for offsetof
+#include <iostream>
+#include <vector>
+#include <assert.h>
+
+#if CHIP8_RECOMPILER
+#include <sys/mman.h>
+#endif
+
+
+namespace {
+
+    constexpr std::size_t ArenaSize = 1 << 20;
+    constexpr Word        MaxBlockLength = 64;
+    constexpr Byte        MaxRewrites = 4;     // more and the byte is left to the interpreter
+    constexpr std::size_t PageSize = 4096; // mprotect granularity, the arena starts at a page
+
+    // x86-64 registers used by the generated code, the Chip8* is passed in rdi
+    enum Reg : Byte { EAX = 0, ECX = 1, EDX = 2, RDI = 7 };
+
+    // Appends machine code. Every access to the machine goes through [rdi + offset],
+    // nothing is kept in registers across instructions, which keeps the CHIP-8 semantics
+    // (Vf being overwritten before Vx is read...) exactly like in the interpreter.
+    struct Emitter {
+        std::vector<Byte> bytes;
+
+        void byte(Byte b) { bytes.push_back(b); }
+
+        void dword(uint32_t d)
+        {
+            for (int n = 0; n < 4; ++n) {
+                byte((d >> (8 * n)) & 0xFF);
+            }
+        }
+
+        // [rdi + disp32]
+        void field(Reg reg, std::size_t offset)
+        {
+            byte(0x80 | (reg << 3) | RDI);
+            dword(uint32_t(offset));
+        }
+
+        // movzx reg, byte [rdi + offset]    (V registers)
+        void load(Reg reg, std::size_t offset)  { byte(0x0F); byte(0xB6); field(reg, offset); }
+
+        // mov byte [rdi + offset], reg
+        void store(std::size_t offset, Reg reg) { byte(0x88); field(reg, offset); }
+
+        // mov byte [rdi + offset], imm8
+        void storeImmediate(std::size_t offset, Byte value) { byte(0xC6); field(EAX, offset); byte(value); }
+
+        // movzx reg, word [rdi + offset]    (I, PC)
+        void loadWord(Reg reg, std::size_t offset)  { byte(0x0F); byte(0xB7); field(reg, offset); }
+
+        // mov word [rdi + offset], reg
+        void storeWord(std::size_t offset, Reg reg) { byte(0x66); byte(0x89); field(reg, offset); }
+
+        // mov word [rdi + offset], imm16
+        void storeWordImmediate(std::size_t offset, Word value)
+        {
+            byte(0x66); byte(0xC7); field(EAX, offset);
+            byte(value & 0xFF); byte(value >> 8);
+        }
+
+        // <op> eax, ecx    (op: 0x01 add, 0x09 or, 0x21 and, 0x29 sub, 0x31 xor, 0x39 cmp)
+        void alu(Byte op) { byte(op); byte(0xC8); }
+
+        // <op> eax, imm32  (op: 0x05 add, 0x3D cmp)
+        void aluImmediate(Byte op, uint32_t value) { byte(op); dword(value); }
+
+        // mov reg, imm32
+        void move(Reg reg, uint32_t value) { byte(0xB8 + reg); dword(value); }
+
+        // edx := 1 if the last compare was 'above' (unsigned >), 0 otherwise
+        void setAbove() { byte(0x0F); byte(0x97); byte(0xC2); byte(0x0F); byte(0xB6); byte(0xD2); }
+
+        // cmovcc edx, ecx  (cc: 0x4 equal, 0x5 not equal)
+        void conditionalMove(Byte cc) { byte(0x0F); byte(0x40 | cc); byte(0xD1); }
+
+        void ret() { byte(0xC3); }
+    };
+
+    constexpr std::size_t offsetV(int reg) { return offsetof(Chip8, V) + reg * sizeof(Byte); }
+    constexpr std::size_t OffsetI  = offsetof(Chip8, I);
+    constexpr std::size_t OffsetPC = offsetof(Chip8, PC);
+
+    constexpr Byte ConditionEqual    = 0x4;
+    constexpr Byte ConditionNotEqual = 0x5;
+
+    // PC := condition ? skip : next
+    void emitSkip(Emitter& e, Byte condition, Word next)
+    {
+        e.move(EDX, next);
+        e.move(ECX, next + 2);
+        e.conditionalMove(condition);
+        e.storeWord(OffsetPC, EDX);
+    }
+
+    // Vf := <flag of the compare>; Vx := Vx <op> Vy   (Vx, Vy are read again, one of them might be Vf)
+    void emitArithmetic(Emitter& e, Byte op, int x, int lhs, int rhs)
+    {
+        e.store(offsetV(VF), EDX);
+        e.load(EAX, offsetV(lhs));
+        e.load(ECX, offsetV(rhs));
+        e.alu(op);
+        e.store(offsetV(x), EAX);
+    }
+
+    enum class Translation { Continue, End, NotTranslated };
+
+    // Translates a single opcode, 'next' is the address of the following instruction.
+    Translation translate(Emitter& e, OpCode op, Word next, Quirks const& quirks)
+    {
+        const int x   = (op & 0x0F00) >> 8;
+        const int y   = (op & 0x00F0) >> 4;
+        const int nn  = (op & 0x00FF);
+        const int nnn = (op & 0x0FFF);
+
+        switch (op & 0xF000) {
+
+        // 1nnn  goto nnn.
+        case 0x1000:
+            e.storeWordImmediate(OffsetPC, nnn);
+            return Translation::End;
+
+        // 3xnn / 4xnn  skip next instruction if VX ==/!= NN
+        case 0x3000:
+        case 0x4000:
+            e.load(EAX, offsetV(x));
+            e.aluImmediate(0x3D, nn);
+            emitSkip(e, (op & 0xF000) == 0x3000 ? ConditionEqual : ConditionNotEqual, next);
+            return Translation::End;
+
+        // 5xy0 / 9xy0  skip next instruction if VX ==/!= VY
+        case 0x5000:
+        case 0x9000:
+            if ((op & 0x000F) != 0) {
+                return Translation::NotTranslated;
+            }
+            e.load(EAX, offsetV(x));
+            e.load(ECX, offsetV(y));
+            e.alu(0x39);
+            emitSkip(e, (op & 0xF000) == 0x5000 ? ConditionEqual : ConditionNotEqual, next);
+            return Translation::End;
+
+        // 6xnn  Vx := nn
+        case 0x6000:
+            e.storeImmediate(offsetV(x), nn);
+            return Translation::Continue;
+
+        // 7XNN  Vx := Vx + nn (no carry)
+        case 0x7000:
+            e.load(EAX, offsetV(x));
+            e.aluImmediate(0x05, nn);
+            e.store(offsetV(x), EAX);
+            return Translation::Continue;
+
+        // 8nnn
+        case 0x8000:
+            switch (op & 0x000F) {
+
+            // 8xy0  Vx := Vy
+            case 0x0000:
+                e.load(EAX, offsetV(y));
+                e.store(offsetV(x), EAX);
+                return Translation::Continue;
+
+            // 8xy1, 8xy2, 8xy3  Vx := Vx or/and/xor Vy, the VIP resets Vf
+            case 0x0001:
+            case 0x0002:
+            case 0x0003: {
+                const Byte ops[] = { 0, 0x09, 0x21, 0x31 };
+                e.load(EAX, offsetV(x));
+                e.load(ECX, offsetV(y));
+                e.alu(ops[op & 0x000F]);
+                e.store(offsetV(x), EAX);
+                if (quirks.resetVF) {
+                    e.storeImmediate(offsetV(VF), 0);
+                }
+                return Translation::Continue;
+            }
+
+            // 8xy4  Vx := Vx + Vy, Vf == carry
+            case 0x0004:
+                e.load(EAX, offsetV(x));
+                e.load(ECX, offsetV(y));
+                e.alu(0x01);
+                e.aluImmediate(0x3D, 255);
+                e.setAbove();
+                emitArithmetic(e, 0x01, x, x, y);
+                return Translation::Continue;
+
+            // 8xy5  Vx := Vx - Vy, Vf == borrow
+            case 0x0005:
+                e.load(EAX, offsetV(x));
+                e.load(ECX, offsetV(y));
+                e.alu(0x39);
+                e.setAbove();
+                emitArithmetic(e, 0x29, x, x, y);
+                return Translation::Continue;
+
+            // 8xy7  Vx := Vy - Vx, Vf == borrow
+            case 0x0007:
+                e.load(EAX, offsetV(y));
+                e.load(ECX, offsetV(x));
+                e.alu(0x39);
+                e.setAbove();
+                emitArithmetic(e, 0x29, x, y, x);
+                return Translation::Continue;
+            }
+            return Translation::NotTranslated;
+
+        // Annn  I := nnn
+        case 0xA000:
+            e.storeWordImmediate(OffsetI, nnn);
+            return Translation::Continue;
+
+        // Fx1E  I := I + Vx
+        case 0xF000:
+            if ((op & 0x00FF) == 0x001E) {
+                e.loadWord(EAX, OffsetI);
+                e.load(ECX, offsetV(x));
+                e.alu(0x01);
+                e.storeWord(OffsetI, EAX);
+                return Translation::Continue;
+            }
+            return Translation::NotTranslated;
+        }
+
+        return Translation::NotTranslated;
+    }
+
+}
+
+Recompiler::Recompiler(Chip8& chip, Engine engine, Dialect dialect, OnUnknown onUnknown)
+    : chip(chip)
+    , engine(engine)
+    , dialect(dialect)
+    , interpreter(chip, dialect, onUnknown)
+{
+#if CHIP8_RECOMPILER
+    if (engine != Engine::Interpreter) {
+        // pages become writable while a block is copied in, see translate()
+        void* memory = mmap(nullptr, ArenaSize, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory != MAP_FAILED) {
+            arena = static_cast<Byte*>(memory);
+        }
+    }
+#endif
+}
+
+Recompiler::~Recompiler()
+{
+#if CHIP8_RECOMPILER
+    if (arena) {
+        munmap(arena, ArenaSize);
+    }
+#endif
+}
+
+std::size_t Recompiler::step()
+{
+    auto const& block = lookup();
+    if (!block.code) {
+        interpret();
+        return 1;
+    }
+    execute(block);
+    return block.count;
+}
+
+void Recompiler::execute(Block const& block)
+{
+#if CHIP8_PROFILE
+    if (profile) {
+        profile->block(chip, chip.PC, block.count);
+    }
+#endif
+
+    if (engine == Engine::Differential) {
+        const Chip8 before = chip;
+        block.code(&chip);
+        verify(before, block);
+    }
+    else {
+        block.code(&chip);
+    }
+}
+
+void Recompiler::run(std::size_t steps)
+{
+    while (steps > 0) {
+        auto const& block = lookup();
+        if (block.code && block.count <= steps) {
+            execute(block);
+            steps -= block.count;
+        }
+        else {
+            interpret();
+            steps--;
+        }
+    }
+}
+
+void Recompiler::invalidate(Word address, Word length)
+{
+    // a block is at most MaxBlockLength instructions long, only the ones starting that far back can overlap
+    const int first = std::max(0, int(address) - 2 * MaxBlockLength + 1);
+    const int end = std::min(int(address) + int(length), int(blocks.size()));
+    for (int start = first; start < end; ++start) {
+        auto& block = blocks[std::size_t(start)];
+        if (!block.translated || start + 2 * std::max<int>(block.count, 1) <= address) {
+            continue;
+        }
+        for (int n = start; n < start + 2 * block.count; ++n) {
+            coverage[std::size_t(n)]--;
+        }
+        block = Block{};
+    }
+}
+
+void Recompiler::flush()
+{
+    blocks.fill(Block{});
+    coverage.fill(0);
+    arenaUsed = 0;
+}
+
+Recompiler::Block const& Recompiler::lookup()
+{
+    auto& block = blocks[chip.PC & 0x0FFF];
+    if (!block.translated && arena) {
+        block = translate(chip.PC & 0x0FFF);
+    }
+    return block;
+}
+
+Recompiler::Block Recompiler::translate(Word address)
+{
+    Block block;
+    block.translated = true;
+
+    Emitter e;
+    Word pc = address;
+    bool terminated = false;
+
+    while (!terminated && block.count < MaxBlockLength && std::size_t(pc) + 1 < chip.memory.size()) {
+        if (rewrites[pc] >= MaxRewrites || rewrites[pc + 1] >= MaxRewrites) {
+            break;
+        }
+        const OpCode op = chip.memory[pc] << 8 | chip.memory[pc + 1];
+        const auto result = ::translate(e, op, pc + 2, quirks(dialect));
+        if (result == Translation::NotTranslated) {
+            break;
+        }
+
+        block.count++;
+        pc += 2;
+        terminated = result == Translation::End;
+    }
+
+    if (block.count == 0) {
+        return block; // the interpreter has to do it
+    }
+
+    if (!terminated) {
+        e.storeWordImmediate(OffsetPC, pc);
+    }
+    e.ret();
+
+    if (arenaUsed + e.bytes.size() > ArenaSize) {
+        flush();
+    }
+
+#if CHIP8_RECOMPILER
+    // writable only while the block is copied in; if the protection can't be changed, it's interpreted
+    Byte* const page = arena + (arenaUsed & ~(PageSize - 1));
+    const std::size_t span = std::size_t(arena + arenaUsed + e.bytes.size() - page);
+    if (mprotect(page, span, PROT_READ | PROT_WRITE) != 0) {
+        return Block{ nullptr, 0, true };
+    }
+    std::copy(e.bytes.begin(), e.bytes.end(), arena + arenaUsed);
+    if (mprotect(page, span, PROT_READ | PROT_EXEC) != 0) {
+        return Block{ nullptr, 0, true };
+    }
+#endif
+    block.code = reinterpret_cast<Code>(arena + arenaUsed);
+    arenaUsed += e.bytes.size();
+
+    for (Word n = address; n < pc; ++n) {
+        coverage[n]++;
+    }
+    return block;
+}
+
+void Recompiler::interpret()
+{
+    // the writes of Fx33/Fx55 have to be checked against the translated ranges
+    auto const& in = interpreter.fetch();
+    const Word target = chip.I;
+    const Word writes = in.writes;
+
+    interpreter.step();
+
+    for (int addr = target; addr < target + writes; ++addr) {
+        if (coverage[addr & 0x0FFF]) {
+            invalidate(addr & 0x0FFF, 1);
+            rewrites[addr & 0x0FFF] += rewrites[addr & 0x0FFF] < MaxRewrites ? 1 : 0;
+        }
+    }
+}
+
+void Recompiler::verify(Chip8 const& before, Block const& block)
+{
+    Chip8 reference = before;
+    for (Word n = 0; n < block.count; ++n) {
+        reference.emulate(reference.currentOp(), dialect);
+    }
+
+    const bool equal = reference.V == chip.V && reference.I == chip.I && reference.PC == chip.PC
+                    && reference.SI == chip.SI && reference.stack == chip.stack && reference.screen == chip.screen;
+    if (!equal) {
+        mismatch = true;
+        std::cout << "Recompiler mismatch in block 0x" << std::hex << before.PC << std::dec << " (" << block.count << " instructions)\n";
+        std::cout << "interpreter:\n" << reference << "recompiler:\n" << chip;
+        assert(false);
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+
+#include "Chip8.h"
+#include "DecodeCache.h"
+
+// x86-64 code generation is only available for the System V calling convention (linux, macos)
+#if defined(__x86_64__) && (defined(__unix__) || defined(__APPLE__))
+#define CHIP8_RECOMPILER 1
+#else
+#define CHIP8_RECOMPILER 0
+#endif
+
+enum class Engine {
+    Interpreter,  // DecodeCache only
+    Recompiler,   // translated blocks, DecodeCache for everything that isn't translated
+    Differential  // like Recompiler, but every block is checked against Chip8::emulate
+};
+
+// Dynamic recompiler: straight-line runs of opcodes are translated into native x86-64 code.
+// A block ends after a jump/skip (1nnn, 3xnn, 4xnn, 5xy0, 9xy0) or right before the first opcode
+// that isn't translated (2nnn, 00EE, Bnnn, Dxyn, Fx..); those are executed by the interpreter.
+// Fx33/Fx55 writes into a translated range throw away the blocks that cover the written bytes.
+// Bytes that keep being rewritten (self-modifying loops) aren't translated again, a block ends
+// before them and the interpreter executes them.
+// The generated code is never writable and executable at the same time: the pages of a new block
+// are writable while it is emitted and executable (read-only) afterwards.
+class Recompiler {
+public:
+    // unknown opcodes are never translated, 'onUnknown' is what the interpreter does with them
+    explicit Recompiler(Chip8& chip, Engine engine = Engine::Recompiler, Dialect dialect = Dialect::Modern,
+                        OnUnknown onUnknown = OnUnknown::Assert);
+    ~Recompiler();
+
+    Recompiler(Recompiler const&) = delete;
+    Recompiler& operator = (Recompiler const&) = delete;
+
+    // executes the block at PC or a single interpreted instruction; returns the number of executed instructions
+    std::size_t step();
+
+    // executes exactly 'steps' instructions
+    void run(std::size_t steps);
+
+    // forgets the translated blocks that overlap [address, address + length)
+    void invalidate(Word address, Word length);
+
+    // forgets all translated blocks
+    void flush();
+
+    // true after the differential mode found a block that behaves different than the interpreter
+    bool diverged() const { return mismatch; }
+
+#if CHIP8_PROFILE
+    void setProfile(Profile* value) { profile = value; interpreter.setProfile(value); }
+#endif
+
+private:
+    using Code = void (*)(Chip8*);
+
+    struct Block {
+        Code code = nullptr;
+        Word count = 0;        // number of translated instructions
+        bool translated = false;
+    };
+
+    Block const& lookup();
+    Block translate(Word address);
+    void execute(Block const& block);
+    void interpret();
+    void verify(Chip8 const& before, Block const& block);
+
+    Chip8&      chip;
+    Engine      engine;
+    Dialect     dialect;
+    DecodeCache interpreter;
+
+    std::array<Block, 4096> blocks = {};
+    std::array<Byte, 4096>  coverage = {}; // number of translated blocks each byte is part of
+    std::array<Byte, 4096>  rewrites = {}; // how often a write threw away blocks that covered a byte
+
+    Byte*       arena = nullptr;   // executable memory, blocks are appended until it is full
+    std::size_t arenaUsed = 0;
+
+    bool mismatch = false;
+
+#if CHIP8_PROFILE
+    Profile* profile = nullptr;
+#endif
+};
@@ -0,0 +1,152 @@
+// Headless replay of recorded movies (see Movie.h), no SDL involved.
+//
+//   chip8-replay [options] movie ...
+//
+//   --rom FILE     a rom the movies may have been recorded with
+//   --dir DIR      every file in DIR
+//   --pack FILE    every rom in the pack FILE
+//   --threads N    worker threads (default: all cores)
+//   --rebase       store the replayed hash streams in the movies as the new reference
+//   --hashes       also print the hash of every frame
+//
+// The rom of a movie is found by its hash. Prints one line per movie: "ok" and the frame count, or
+// the first frame whose hash differs from the recorded one with the PC after it.
+// Exits with 1 if a movie diverged or its rom wasn't given.
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Movie.h"
+#include "RomLibrary.h"
+#include "ThreadPool.h"
+
+
+namespace {
+
+    void usage()
+    {
+        std::cout << "usage: chip8-replay [--rom FILE] [--dir DIR] [--pack FILE] [--threads N] [--rebase] [--hashes] movie ...\n";
+    }
+
+    std::ostream& hex(std::ostream& os, uint64_t value, int width = 16)
+    {
+        return os << std::hex << std::setfill('0') << std::setw(width) << value << std::dec;
+    }
+
+}
+
+int main(int argc, char** argv)
+{
+    unsigned threads = std::thread::hardware_concurrency();
+    bool     rebase  = false;
+    bool     hashes  = false;
+
+    RomLibrary library;
+    std::vector<std::string> paths;
+    for (int n = 1; n < argc; ++n) {
+        const std::string arg = argv[n];
+        const bool hasValue = n + 1 < argc;
+
+        if (arg == "--rom" && hasValue) {
+            if (!library.addFile(argv[++n])) { std::cout << "Can't read rom " << argv[n] << '\n'; return EXIT_FAILURE; }
+        }
+        else if (arg == "--dir" && hasValue) {
+            if (!library.addDirectory(argv[++n])) { std::cout << "Can't read directory " << argv[n] << '\n'; return EXIT_FAILURE; }
+        }
+        else if (arg == "--pack" && hasValue) {
+            if (!library.addPack(argv[++n])) { std::cout << "Can't read pack " << argv[n] << '\n'; return EXIT_FAILURE; }
+        }
+        else if (arg == "--threads" && hasValue) { threads = unsigned(std::strtoul(argv[++n], nullptr, 10)); }
+        else if (arg == "--rebase")              { rebase = true; }
+        else if (arg == "--hashes")              { hashes = true; }
+        else if (arg.rfind("--", 0) == 0)        { usage(); return EXIT_FAILURE; }
+        else                                     { paths.push_back(arg); }
+    }
+
+    if (paths.empty()) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    std::vector<Movie> movies(paths.size());
+    for (std::size_t n = 0; n < paths.size(); ++n) {
+        if (!loadMovie(paths[n], movies[n])) {
+            std::cout << "Can't read movie " << paths[n] << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+
+    // the movies are independent, one task each
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<ReplayResult> results(movies.size());
+    std::vector<Rom const*> roms(movies.size());
+    {
+        ThreadPool pool(threads);
+        for (std::size_t n = 0; n < movies.size(); ++n) {
+            roms[n] = library.find(movies[n].romHash);
+            if (roms[n]) {
+                pool.submit([&, n] { results[n] = replay(movies[n], roms[n]->data, roms[n]->size); });
+            }
+        }
+        pool.wait();
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    bool failed = false;
+    uint64_t total = 0;
+    for (std::size_t n = 0; n < movies.size(); ++n) {
+        auto const& r = results[n];
+        total += r.frames;
+        std::cout << paths[n] << ' ';
+
+        if (!roms[n]) {
+            hex(std::cout << "rom not found, hash ", movies[n].romHash) << '\n';
+            failed = true;
+            continue;
+        }
+        if (!r.loaded) {
+            std::cout << "rom too big\n";
+            failed = true;
+            continue;
+        }
+
+        if (r.diverged) {
+            std::cout << "diverged at frame " << r.frame << ", pc ";
+            hex(std::cout, r.pc, 3) << ", expected ";
+            hex(std::cout, r.expected) << ", got ";
+            hex(std::cout, r.actual) << '\n';
+            if (!rebase) {
+                failed = true;
+            }
+        }
+        else {
+            std::cout << "ok " << r.frames << " frames" << (movies[n].hashes.empty() ? " (no reference)" : "") << '\n';
+        }
+
+        if (hashes) {
+            for (std::size_t f = 0; f < r.hashes.size(); ++f) {
+                hex(std::cout << "  " << f << ' ', r.hashes[f]) << '\n';
+            }
+        }
+
+        // a diverged replay stopped early, the new reference has to cover the whole movie
+        if (rebase) {
+            Movie rebased = movies[n];
+            rebased.hashes.clear();
+            rebased.hashes = r.diverged ? replay(rebased, roms[n]->data, roms[n]->size).hashes : r.hashes;
+            if (!saveMovie(paths[n], rebased)) {
+                std::cout << "Can't write movie " << paths[n] << '\n';
+                failed = true;
+            }
+        }
+    }
+
+    std::cout << movies.size() << " movies, " << total << " frames in " << seconds << " s, "
+              << (seconds > 0 ? total / seconds : 0) << " frames/s\n";
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,226 @@
+#include "Rewind.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <cstring>
+
+
+namespace {
+
+    // a state that isn't a delta is encoded against this
+    const Chip8::State Zero = {};
+
+    // shorter equal stretches are cheaper to keep in the literals than to start a new run
+    constexpr std::size_t MinZeroRun = 4;
+
+    void putVarint(std::vector<Byte>& out, std::size_t value)
+    {
+        while (value >= 0x80) {
+            out.push_back(Byte(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(Byte(value));
+    }
+
+    bool getVarint(Byte const*& in, Byte const* end, std::size_t& value)
+    {
+        value = 0;
+        for (int shift = 0; in < end && shift < 32; shift += 7) {
+            const Byte b = *in++;
+            value |= std::size_t(b & 0x7F) << shift;
+            if (!(b & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    uint64_t word(Byte const* p)
+    {
+        uint64_t w;
+        std::memcpy(&w, p, sizeof(w));
+        return w;
+    }
+
+    // first position >= n where a and b differ
+    std::size_t skipEqual(Byte const* a, Byte const* b, std::size_t n, std::size_t size)
+    {
+        // most of the state doesn't change between frames, compare 8 bytes at once
+        while (n + 8 <= size && word(a + n) == word(b + n)) {
+            n += 8;
+        }
+        while (n < size && a[n] == b[n]) {
+            ++n;
+        }
+        return n;
+    }
+
+}
+
+void encodeDelta(Chip8::State const& base, Chip8::State const& state, std::vector<Byte>& out)
+{
+    const std::size_t size = state.size();
+    out.clear();
+
+    std::size_t n = 0;
+    while (n < size) {
+        const std::size_t literals = skipEqual(base.data(), state.data(), n, size);
+        std::size_t end = literals;
+
+        // the literals end at the next long enough run of equal bytes
+        while (end < size) {
+            const std::size_t equal = skipEqual(base.data(), state.data(), end, std::min(size, end + MinZeroRun));
+            if (equal == std::min(size, end + MinZeroRun)) {
+                break;
+            }
+            end = equal + 1;
+        }
+
+        putVarint(out, literals - n);
+        putVarint(out, end - literals);
+        for (std::size_t i = literals; i < end; ++i) {
+            out.push_back(base[i] ^ state[i]);
+        }
+        n = end;
+    }
+}
+
+bool applyDelta(Byte const* delta, std::size_t size, Chip8::State& state)
+{
+    Byte const* in = delta;
+    Byte const* end = delta + size;
+
+    std::size_t n = 0;
+    while (in < end) {
+        std::size_t zeros = 0;
+        std::size_t literals = 0;
+        if (!getVarint(in, end, zeros) || !getVarint(in, end, literals)) {
+            return false;
+        }
+        if (zeros > state.size() - n || literals > state.size() - n - zeros || literals > std::size_t(end - in)) {
+            return false;
+        }
+
+        n += zeros;
+        for (std::size_t i = 0; i < literals; ++i) {
+            state[n++] ^= *in++;
+        }
+    }
+    return true;
+}
+
+Rewind::Rewind(std::size_t capacity, unsigned keyframeInterval)
+    // a keyframe never needs more than the raw state plus the run headers
+    : data(std::max(capacity, 4 * Chip8::StateSize))
+    , interval(std::max(1u, keyframeInterval))
+{
+    encoded.reserve(2 * Chip8::StateSize);
+}
+
+void Rewind::push(Chip8 const& chip)
+{
+    chip.save(current);
+
+    bool keyframe = entries.empty() || pushes - baseNumber >= interval;
+    if (!keyframe) {
+        encodeDelta(base, current, encoded);
+        makeRoom(encoded.size());
+
+        // the buffer is too small for a whole keyframe interval, the base just got dropped
+        keyframe = entries.empty() || entries.front().number > baseNumber;
+    }
+    if (keyframe) {
+        base = current;
+        baseNumber = pushes;
+        encodeDelta(Zero, current, encoded);
+        makeRoom(encoded.size());
+    }
+
+    std::copy(encoded.begin(), encoded.end(), data.begin() + head);
+    entries.push_back(Entry{ head, encoded.size(), baseNumber, pushes });
+    head += encoded.size();
+    pushes++;
+}
+
+void Rewind::makeRoom(std::size_t size)
+{
+    // entries are never split, wrap around early instead - everything behind 'head' is from the last lap
+    if (head + size > data.size()) {
+        while (!entries.empty() && entries.front().offset >= head) {
+            entries.pop_front();
+        }
+        head = 0;
+    }
+
+    // the oldest entries are the ones right behind the write position
+    const auto overlaps = [&](Entry const& e) { return e.offset < head + size && head < e.offset + e.size; };
+    while (!entries.empty() && overlaps(entries.front())) {
+        entries.pop_front();
+    }
+
+    // deltas without their keyframe are useless
+    while (!entries.empty() && entries.front().keyframe != entries.front().number) {
+        entries.pop_front();
+    }
+}
+
+void Rewind::decode(std::size_t index, Chip8::State& state) const
+{
+    auto const& entry = entries[index];
+    auto const& key = entries[index - std::size_t(entry.number - entry.keyframe)];
+
+    // only written by encodeDelta(), so it can't be broken
+    state = Zero;
+    if (!applyDelta(data.data() + key.offset, key.size, state)) {
+        assert(false);
+    }
+    if (&key != &entry && !applyDelta(data.data() + entry.offset, entry.size, state)) {
+        assert(false);
+    }
+}
+
+bool Rewind::rewind(Chip8& chip, std::size_t back)
+{
+    if (!peek(chip, back)) {
+        return false;
+    }
+
+    const std::size_t index = entries.size() - 1 - back;
+    entries.resize(index + 1);
+
+    auto const& entry = entries.back();
+    head = entry.offset + entry.size;
+    pushes = entry.number + 1;
+    baseNumber = entry.keyframe;
+    decode(index - std::size_t(entry.number - entry.keyframe), base);
+    return true;
+}
+
+bool Rewind::peek(Chip8& chip, std::size_t back) const
+{
+    if (back >= entries.size()) {
+        return false;
+    }
+
+    Chip8::State state;
+    decode(entries.size() - 1 - back, state);
+    chip.restore(state);
+    return true;
+}
+
+void Rewind::clear()
+{
+    entries.clear();
+    head = 0;
+    pushes = 0;
+    baseNumber = 0;
+}
+
+std::size_t Rewind::bytes() const
+{
+    std::size_t total = 0;
+    for (auto const& e : entries) {
+        total += e.size;
+    }
+    return total;
+}
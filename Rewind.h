@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "Chip8.h"
+
+// History of machine states in a fixed amount of memory, meant to be fed once per frame.
+// Every 'keyframeInterval'th state is a keyframe, the others only store their difference to
+// the last keyframe: the states are XOR'ed and the result is run-length encoded (between two
+// frames little changes - some screen rows and registers, so a delta is a few dozen bytes).
+// Keyframes are encoded the same way against an all-zero state, unused memory compresses away.
+// When the buffer is full, the oldest keyframe and its deltas are dropped.
+class Rewind {
+public:
+    explicit Rewind(std::size_t capacity = 4 << 20, unsigned keyframeInterval = 60);
+
+    // records the current state of 'chip'
+    void push(Chip8 const& chip);
+
+    // Restores the state recorded 'back' pushes ago (0 == the latest) into 'chip' and
+    // forgets the newer ones, the next push() continues from there. False if it's too old.
+    bool rewind(Chip8& chip, std::size_t back = 0);
+
+    // like rewind(), but keeps the history - for branching off the same state many times
+    bool peek(Chip8& chip, std::size_t back = 0) const;
+
+    void clear();
+
+    std::size_t size() const { return entries.size(); } // recorded states
+    std::size_t bytes() const;                           // memory used by them
+
+private:
+    struct Entry {
+        std::size_t offset;   // in 'data'
+        std::size_t size;
+        uint64_t    keyframe; // number of the keyframe this delta is based on
+        uint64_t    number;   // number of this state, counts all pushes
+    };
+
+    void makeRoom(std::size_t size);
+    void decode(std::size_t index, Chip8::State& state) const;
+
+    std::vector<Byte>  data;      // ring buffer of encoded states
+    std::deque<Entry>  entries;   // oldest first
+    std::size_t        head = 0;  // write position in 'data'
+    unsigned           interval;
+    uint64_t           pushes = 0;
+
+    Chip8::State       base = {};         // the keyframe new deltas are based on
+    uint64_t           baseNumber = 0;
+    Chip8::State       current = {};
+    std::vector<Byte>  encoded;
+};
+
+// XOR of 'state' and 'base', run-length encoded: repeated [zero count][literal count][literals...],
+// both counts as LEB128 varints. 'out' is replaced.
+void encodeDelta(Chip8::State const& base, Chip8::State const& state, std::vector<Byte>& out);
+
+// Inverse of encodeDelta(): 'state' has to hold the base and becomes the encoded state.
+// False (and 'state' is garbage) if the delta is broken.
+bool applyDelta(Byte const* delta, std::size_t size, Chip8::State& state);
@@ -0,0 +1,376 @@
+#include "RomLibrary.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+#include "Hash.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CHIP8_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define CHIP8_MMAP 0
+#endif
+
+
+// a whole file, mapped (or read, where there is no mmap)
+struct RomLibrary::Mapping {
+    Byte const*       data = nullptr;
+    std::size_t       size = 0;
+#if CHIP8_MMAP
+    void*             mapped = nullptr;
+#else
+    std::vector<Byte> copy;
+#endif
+
+    bool open(std::string const& path)
+    {
+#if CHIP8_MMAP
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+
+        struct stat info;
+        const bool ok = fstat(fd, &info) == 0 && S_ISREG(info.st_mode);
+        if (ok && info.st_size > 0) {
+            mapped = mmap(nullptr, std::size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd); // the mapping stays valid
+
+        if (!ok || mapped == MAP_FAILED) {
+            mapped = nullptr;
+            return false;
+        }
+
+        // an empty file can't be mapped, it's an empty rom
+        data = mapped ? static_cast<Byte const*>(mapped) : nullptr;
+        size = mapped ? std::size_t(info.st_size) : 0;
+        return true;
+#else
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            return false;
+        }
+        copy.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        data = copy.data();
+        size = copy.size();
+        return true;
+#endif
+    }
+
+    ~Mapping()
+    {
+#if CHIP8_MMAP
+        if (mapped) {
+            munmap(mapped, size);
+        }
+#endif
+    }
+};
+
+namespace {
+
+    const char PackMagic[4]  = { 'C', '8', 'P', 'K' };
+    const char IndexMagic[4] = { 'C', '8', 'I', 'X' };
+    constexpr std::size_t HeaderSize     = 16;
+    constexpr std::size_t PackEntrySize  = 24;
+
+    template <typename T>
+    void put(std::vector<Byte>& out, T value)
+    {
+        for (std::size_t n = 0; n < sizeof(T); ++n) {
+            out.push_back(Byte(value >> (8 * n)));
+        }
+    }
+
+    template <typename T>
+    T get(Byte const* in)
+    {
+        T value = 0;
+        for (std::size_t n = 0; n < sizeof(T); ++n) {
+            value |= T(T(in[n]) << (8 * n));
+        }
+        return value;
+    }
+
+    void header(std::vector<Byte>& out, char const (&magic)[4], uint32_t version, uint32_t count, uint32_t extra)
+    {
+        out.insert(out.end(), magic, magic + 4);
+        put(out, version);
+        put(out, count);
+        put(out, extra);
+    }
+
+    bool writeFile(std::string const& path, std::vector<Byte> const& data)
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<char const*>(data.data()), std::streamsize(data.size()));
+        return bool(out);
+    }
+
+    std::string fileTitle(std::string const& name)
+    {
+        return std::filesystem::path(name).stem().string();
+    }
+
+}
+
+RomLibrary::RomLibrary() = default;
+RomLibrary::~RomLibrary() = default;
+
+bool RomLibrary::add(std::string const& path, Mapping*& mapping)
+{
+    auto file = std::make_unique<Mapping>();
+    if (!file->open(path)) {
+        return false;
+    }
+    mapping = file.get();
+    mappings.push_back(std::move(file));
+    return true;
+}
+
+bool RomLibrary::addFile(std::string const& path)
+{
+    Mapping* file = nullptr;
+    if (!add(path, file)) {
+        return false;
+    }
+
+    Rom rom;
+    rom.name = path;
+    rom.data = file->data;
+    rom.size = file->size;
+    rom.hash = hash(rom.data, rom.size);
+
+    byHash.emplace(rom.hash, entries.size());
+    entries.push_back(rom);
+    return true;
+}
+
+bool RomLibrary::addDirectory(std::string const& path)
+{
+    std::error_code error;
+    std::vector<std::string> files;
+    for (auto const& entry : std::filesystem::directory_iterator(path, error)) {
+        if (entry.is_regular_file(error)) {
+            files.push_back(entry.path().string());
+        }
+    }
+    if (error) {
+        return false;
+    }
+
+    std::sort(files.begin(), files.end());
+    for (auto const& file : files) {
+        if (!addFile(file)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool RomLibrary::addPack(std::string const& path)
+{
+    Mapping* file = nullptr;
+    if (!add(path, file)) {
+        return false;
+    }
+
+    Byte const* data = file->data;
+    const std::size_t size = file->size;
+    if (size < HeaderSize || std::memcmp(data, PackMagic, sizeof(PackMagic)) != 0 || get<uint32_t>(data + 4) != RomPackVersion) {
+        return false;
+    }
+
+    const std::size_t count = get<uint32_t>(data + 8);
+    if (count > (size - HeaderSize) / PackEntrySize) {
+        return false;
+    }
+
+    // everything is checked before anything is added
+    std::vector<Rom> roms(count);
+    for (std::size_t n = 0; n < count; ++n) {
+        Byte const* entry = data + HeaderSize + n * PackEntrySize;
+        const uint64_t offset     = get<uint32_t>(entry + 8);
+        const uint64_t length     = get<uint32_t>(entry + 12);
+        const uint64_t nameOffset = get<uint32_t>(entry + 16);
+        const uint64_t nameLength = get<uint32_t>(entry + 20);
+        if (offset + length > size || nameOffset + nameLength > size) {
+            return false;
+        }
+
+        auto& rom = roms[n];
+        rom.name.assign(reinterpret_cast<char const*>(data + nameOffset), std::size_t(nameLength));
+        rom.data = data + offset;
+        rom.size = std::size_t(length);
+        rom.hash = hash(rom.data, rom.size);
+        if (rom.hash != get<uint64_t>(entry)) {
+            return false;
+        }
+    }
+
+    for (auto& rom : roms) {
+        byHash.emplace(rom.hash, entries.size());
+        entries.push_back(std::move(rom));
+    }
+    return true;
+}
+
+Rom const* RomLibrary::find(uint64_t romHash) const
+{
+    const auto it = byHash.find(romHash);
+    return it != byHash.end() ? &entries[it->second] : nullptr;
+}
+
+bool writePack(std::string const& path, std::vector<Rom> const& roms)
+{
+    std::vector<Byte> out;
+    header(out, PackMagic, RomPackVersion, uint32_t(roms.size()), 0);
+
+    // the names are stored without their directories
+    std::size_t names = HeaderSize + roms.size() * PackEntrySize;
+    std::size_t data = names;
+    std::size_t end = names;
+    for (auto const& rom : roms) {
+        const std::size_t nameSize = std::filesystem::path(rom.name).filename().string().size();
+        data += nameSize;
+        end += nameSize + rom.size;
+    }
+    if (end > UINT32_MAX) {
+        return false;
+    }
+
+    for (auto const& rom : roms) {
+        const auto name = std::filesystem::path(rom.name).filename().string();
+        put(out, rom.hash);
+        put(out, uint32_t(data));
+        put(out, uint32_t(rom.size));
+        put(out, uint32_t(names));
+        put(out, uint32_t(name.size()));
+        names += name.size();
+        data += rom.size;
+    }
+    for (auto const& rom : roms) {
+        const auto name = std::filesystem::path(rom.name).filename().string();
+        out.insert(out.end(), name.begin(), name.end());
+    }
+    for (auto const& rom : roms) {
+        out.insert(out.end(), rom.data, rom.data + rom.size);
+    }
+    return writeFile(path, out);
+}
+
+bool RomIndex::load(std::string const& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    const std::vector<Byte> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    if (data.size() < HeaderSize || std::memcmp(data.data(), IndexMagic, sizeof(IndexMagic)) != 0 ||
+        get<uint32_t>(data.data() + 4) != RomIndexVersion ||
+        get<uint32_t>(data.data() + 12) != uint32_t(hash(data.data() + HeaderSize, data.size() - HeaderSize))) {
+        return false;
+    }
+
+    std::unordered_map<uint64_t, RomMeta> parsed;
+    const std::size_t count = get<uint32_t>(data.data() + 8);
+    std::size_t at = HeaderSize;
+    for (std::size_t n = 0; n < count; ++n) {
+        constexpr std::size_t Fixed = 8 + 4 + 2;
+        if (at + Fixed > data.size()) {
+            return false;
+        }
+
+        Byte const* entry = data.data() + at;
+        const std::size_t titleSize = get<uint16_t>(entry + 12);
+        if (at + Fixed + titleSize > data.size() || entry[8] > Byte(Dialect::Modern) || entry[9] > Byte(Extension::XoChip)) {
+            return false;
+        }
+
+        RomMeta meta;
+        meta.dialect      = Dialect(entry[8]);
+        meta.extension    = Extension(entry[9]);
+        meta.extended     = (entry[10] & 1) != 0;
+        meta.title.assign(reinterpret_cast<char const*>(entry + Fixed), titleSize);
+        parsed[get<uint64_t>(entry)] = meta;
+        at += Fixed + titleSize;
+    }
+
+    entries = std::move(parsed);
+    dirty = false;
+    return true;
+}
+
+bool RomIndex::save(std::string const& path) const
+{
+    // sorted by hash, the same index is always the same file
+    std::vector<uint64_t> hashes;
+    for (auto const& e : entries) {
+        hashes.push_back(e.first);
+    }
+    std::sort(hashes.begin(), hashes.end());
+
+    std::vector<Byte> body;
+    for (auto romHash : hashes) {
+        auto const& meta = entries.at(romHash);
+        const std::size_t titleSize = std::min<std::size_t>(meta.title.size(), UINT16_MAX);
+        put(body, romHash);
+        body.push_back(Byte(meta.dialect));
+        body.push_back(Byte(meta.extension));
+        body.push_back(Byte(meta.extended ? 1 : 0));
+        body.push_back(0);
+        put(body, uint16_t(titleSize));
+        body.insert(body.end(), meta.title.begin(), meta.title.begin() + titleSize);
+    }
+
+    std::vector<Byte> out;
+    header(out, IndexMagic, RomIndexVersion, uint32_t(hashes.size()), uint32_t(hash(body.data(), body.size())));
+    out.insert(out.end(), body.begin(), body.end());
+    if (!writeFile(path, out)) {
+        return false;
+    }
+    dirty = false;
+    return true;
+}
+
+RomMeta const& RomIndex::lookup(Rom const& rom, DialectDatabase const* dialects)
+{
+    auto const* known = dialects ? dialects->find(rom.hash) : nullptr;
+
+    // the database may be newer than the index, what it says wins
+    auto it = entries.find(rom.hash);
+    if (it != entries.end()) {
+        RomMeta& meta = it->second;
+        if (known && (meta.dialect != known->dialect || (!known->title.empty() && meta.title != known->title))) {
+            meta.dialect = known->dialect;
+            if (!known->title.empty()) {
+                meta.title = known->title;
+            }
+            dirty = true;
+        }
+        return meta;
+    }
+
+    RomMeta meta;
+    meta.title = fileTitle(rom.name);
+    if (known) {
+        meta.dialect = known->dialect;
+        if (!known->title.empty()) {
+            meta.title = known->title;
+        }
+    }
+
+    meta.extended = needsExtended(rom.data, rom.size, meta.extension);
+
+    dirty = true;
+    return entries.emplace(rom.hash, meta).first->second;
+}
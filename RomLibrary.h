@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Chip8.h"
+#include "Dialects.h"
+#include "Extended.h"
+
+// Thousands of roms without reading or copying them: the files (single roms, whole directories or
+// pack files) are mapped into memory where the platform allows it, a Rom only points into the mapping.
+// Chip8::load copies it from there straight to StartAddress.
+
+// a rom in a mapped file, valid as long as the RomLibrary it came from
+struct Rom {
+    std::string name;       // path of the file, or the name inside the pack
+    Byte const* data = nullptr;
+    std::size_t size = 0;
+    uint64_t    hash = 0;   // of the content (Hash.h), identifies the rom
+};
+
+class RomLibrary {
+public:
+    RomLibrary();
+    ~RomLibrary();
+
+    RomLibrary(RomLibrary const&) = delete;
+    RomLibrary& operator = (RomLibrary const&) = delete;
+
+    // false (and nothing is added) if the file can't be read
+    bool addFile(std::string const& path);
+
+    // every regular file in the directory (not recursive), in name order; false if it can't be read
+    bool addDirectory(std::string const& path);
+
+    // every rom of a pack file (see writePack); false if the file can't be read or is damaged
+    bool addPack(std::string const& path);
+
+    std::vector<Rom> const& roms() const { return entries; }
+
+    // the first rom with that content, nullptr if there is none
+    Rom const* find(uint64_t hash) const;
+
+private:
+    struct Mapping;
+
+    bool add(std::string const& path, Mapping*& mapping);
+
+    std::vector<std::unique_ptr<Mapping>>   mappings;
+    std::vector<Rom>                        entries;
+    std::unordered_map<uint64_t, std::size_t> byHash;
+};
+
+// Pack file: many roms in one file, one mapping for all of them.
+//   "C8PK" magic, u32 version (RomPackVersion), u32 count, u32 0
+//   count * { u64 hash, u32 offset, u32 size, u32 name offset, u32 name size }   (offsets from the file start)
+//   names, rom data
+// All numbers little endian.
+const uint32_t RomPackVersion = 1;
+
+bool writePack(std::string const& path, std::vector<Rom> const& roms);
+
+// What is known about a rom without running it.
+struct RomMeta {
+    std::string title;
+    Dialect     dialect   = Dialect::Modern;
+    bool        extended  = false;                 // needs ExtendedChip8 (see needsExtended)
+    Extension   extension = Extension::SuperChip;  // if extended
+};
+
+// Persistent cache of RomMeta by rom hash, so the roms of a batch are analysed once and not on every run.
+// File: "C8IX" magic, u32 version (RomIndexVersion), u32 count, u32 FNV-1a of the entries (truncated),
+// then count * { u64 hash, u8 dialect, u8 extension, u8 flags (1 extended), u8 0, u16 title size, title }.
+// All numbers little endian.
+const uint32_t RomIndexVersion = 3;
+
+class RomIndex {
+public:
+    // false (and the index is untouched) if the file can't be read, has another version or is damaged
+    bool load(std::string const& path);
+    bool save(std::string const& path) const;
+
+    // the metadata of 'rom', analysed now and remembered if the index doesn't know it yet;
+    // the title and dialect come from 'dialects' if it knows the rom (also over what the index
+    // remembered), else the title is the file name
+    RomMeta const& lookup(Rom const& rom, DialectDatabase const* dialects = nullptr);
+
+    std::size_t size() const { return entries.size(); }
+    bool modified() const { return dirty; } // lookup() added something since load()/save()
+
+private:
+    std::unordered_map<uint64_t, RomMeta> entries;
+    mutable bool dirty = false;
+};
@@ -0,0 +1,114 @@
+#include "SaveState.h"
+
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include "Hash.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CHIP8_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define CHIP8_MMAP 0
+#endif
+
+
+namespace {
+
+    const char Magic[4] = { 'C', '8', 'S', 'S' };
+    constexpr std::size_t HeaderSize = 16;
+
+    void put32(Byte* out, uint32_t value)
+    {
+        for (int n = 0; n < 4; ++n) {
+            out[n] = Byte(value >> (8 * n));
+        }
+    }
+
+    uint32_t get32(Byte const* in)
+    {
+        return uint32_t(in[0]) | uint32_t(in[1]) << 8 | uint32_t(in[2]) << 16 | uint32_t(in[3]) << 24;
+    }
+
+    uint32_t checksum(Byte const* blob)
+    {
+        return uint32_t(hash(blob, Chip8::StateSize));
+    }
+
+    // checks the header and restores the blob behind it
+    bool parse(Byte const* file, std::size_t size, Chip8& chip)
+    {
+        if (size != HeaderSize + Chip8::StateSize || std::memcmp(file, Magic, sizeof(Magic)) != 0) {
+            return false;
+        }
+        if (get32(file + 4) != SaveStateVersion || get32(file + 8) != Chip8::StateSize) {
+            return false;
+        }
+
+        Byte const* blob = file + HeaderSize;
+        if (get32(file + 12) != checksum(blob)) {
+            return false;
+        }
+
+        Chip8::State state;
+        std::memcpy(state.data(), blob, state.size());
+        chip.restore(state);
+        return true;
+    }
+
+}
+
+bool writeSaveState(std::string const& path, Chip8 const& chip)
+{
+    Bytes<HeaderSize + Chip8::StateSize> file = {};
+    Chip8::State state;
+    chip.save(state);
+
+    std::memcpy(file.data(), Magic, sizeof(Magic));
+    put32(file.data() + 4, SaveStateVersion);
+    put32(file.data() + 8, uint32_t(Chip8::StateSize));
+    put32(file.data() + 12, checksum(state.data()));
+    std::memcpy(file.data() + HeaderSize, state.data(), state.size());
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(file.data()), file.size());
+    return bool(out);
+}
+
+bool readSaveState(std::string const& path, Chip8& chip)
+{
+#if CHIP8_MMAP
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat info;
+    void* mapped = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        mapped = mmap(nullptr, std::size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd); // the mapping stays valid
+
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+
+    const bool ok = parse(static_cast<Byte const*>(mapped), std::size_t(info.st_size), chip);
+    munmap(mapped, std::size_t(info.st_size));
+    return ok;
+#else
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+
+    std::vector<Byte> file(HeaderSize + Chip8::StateSize + 1);
+    in.read(reinterpret_cast<char*>(file.data()), file.size());
+    return parse(file.data(), std::size_t(in.gcount()), chip);
+#endif
+}
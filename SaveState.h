@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+
+#include "Chip8.h"
+
+// Save-state files: a 16 byte header followed by the Chip8::State blob.
+//   "C8SS"  magic
+//   u32     format version (SaveStateVersion)
+//   u32     size of the blob (Chip8::StateSize)
+//   u32     FNV-1a of the blob, truncated
+// All numbers little endian. Files are mapped into memory for loading where the platform allows it.
+const uint32_t SaveStateVersion = 1;
+
+bool writeSaveState(std::string const& path, Chip8 const& chip);
+
+// false (and 'chip' is untouched) if the file can't be read, has another version or is damaged
+bool readSaveState(std::string const& path, Chip8& chip);
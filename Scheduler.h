@@ -0,0 +1,190 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <utility>
+
+#include "Chip8.h"
+#include "IdleLoop.h"
+#include "Profile.h"
+
+enum class Pacing {
+    RealTime, // one frame every 1/60 s
+    Multiple, // 'speed' frames every 1/60 s
+    Turbo     // as fast as possible
+};
+
+// Splits the emulated time into frames of 1/60 s: 'instructionsPerFrame' instructions, then the
+// timers tick once. The timers run at 60 Hz of emulated time, no matter how fast the host is,
+// and nothing timer related happens per instruction.
+// Engine is anything with 'void run(std::size_t steps)' that executes exactly 'steps' instructions
+// (DecodeCache, Recompiler).
+// Idle loops (see IdleLoop.h) are recognized once per slice, their iterations up to the next frame
+// boundary are skipped instead of executed. The resulting state and cycle counts are the same.
+template <typename Engine>
+class Scheduler {
+public:
+    static constexpr double FrameRate = 60.0;
+
+    Scheduler(Chip8& chip, Engine& engine, unsigned instructionsPerFrame = 10)
+        : chip(chip)
+        , engine(engine)
+        , instructionsPerFrame(std::max(1u, instructionsPerFrame))
+    {
+    }
+
+    // executes exactly 'n' instructions, the timers tick at every frame boundary on the way
+    void runCycles(uint64_t n)
+    {
+#if CHIP8_PROFILE
+        auto sliceStart = std::chrono::steady_clock::now();
+#endif
+        while (n > 0) {
+            uint64_t slice = std::min<uint64_t>(n, instructionsPerFrame - frameCycle);
+
+            const IdleLoop loop = idleSkipping ? findIdleLoop(chip) : IdleLoop{};
+            if (loop.kind != Idle::None && loop.toHead == 0 && slice >= loop.length) {
+                // only whole iterations, the rest of the slice is executed normally
+                slice -= slice % loop.length;
+                skipIterations(chip, loop);
+                skippedCount += slice;
+            }
+            else {
+                if (loop.kind != Idle::None && loop.toHead > 0) {
+                    slice = std::min<uint64_t>(slice, loop.toHead); // walk to the head, skip from there
+                }
+                engine.run(std::size_t(slice));
+            }
+
+            n -= slice;
+            cycleCount += slice;
+            frameCycle += unsigned(slice);
+
+#if CHIP8_PROFILE
+            const auto now = std::chrono::steady_clock::now();
+            frameTime += now - sliceStart;
+            sliceStart = now;
+#endif
+            if (frameCycle == instructionsPerFrame) {
+                endFrame();
+            }
+        }
+    }
+
+    // executes the rest of the current frame
+    void runFrame()
+    {
+        runCycles(instructionsPerFrame - frameCycle);
+    }
+
+    // runFrame() and then waits as long as the pacing asks for
+    void frame()
+    {
+        runFrame();
+        pace();
+    }
+
+    void setPacing(Pacing value, double speed = 1.0)
+    {
+        pacing = value;
+        multiple = value == Pacing::Multiple ? std::max(speed, 0.01) : 1.0;
+        resetClock();
+    }
+
+    // call after a pause (debugger, window moved...), so the scheduler doesn't try to catch up
+    void resetClock()
+    {
+        clockStart = std::chrono::steady_clock::now();
+        clockFrames = frameCount;
+    }
+
+    // called at every frame boundary, after the timers ticked (a capture takes the screen there,
+    // the slices of runCycles() don't have to end at the frames for it)
+    void setFrameHook(std::function<void()> hook) { frameHook = std::move(hook); }
+
+    // on by default, off executes every instruction (for comparing or profiling the engines)
+    void setIdleSkipping(bool enabled) { idleSkipping = enabled; }
+
+    uint64_t cycles() const { return cycleCount; }
+    uint64_t skippedCycles() const { return skippedCount; } // part of cycles() that was skipped
+
+#if CHIP8_PROFILE
+    // records the host time of every frame; every 'reportInterval' frames the summary goes to 'report'
+    void setProfile(Profile* value, uint64_t reportInterval = 0, std::ostream* report = nullptr)
+    {
+        profile = value;
+        profileInterval = reportInterval;
+        profileReport = report;
+    }
+#endif
+    uint64_t frames() const { return frameCount; }
+    unsigned cyclesPerFrame() const { return instructionsPerFrame; }
+
+private:
+    void endFrame()
+    {
+        chip.updateTimer();
+        frameCycle = 0;
+        frameCount++;
+        if (frameHook) {
+            frameHook();
+        }
+
+#if CHIP8_PROFILE
+        if (profile) {
+            profile->frame(uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(frameTime).count()));
+            if (profileReport && profileInterval && frameCount % profileInterval == 0) {
+                profile->summary(*profileReport);
+            }
+        }
+        frameTime = {};
+#endif
+    }
+
+    void pace()
+    {
+        if (pacing == Pacing::Turbo) {
+            return;
+        }
+
+        // deadlines are computed from the start, rounding errors don't add up over time
+        const auto frameTime = std::chrono::duration<double>(1.0 / (FrameRate * multiple));
+        const auto deadline = clockStart + std::chrono::duration_cast<std::chrono::steady_clock::duration>(frameTime * double(frameCount - clockFrames));
+        const auto now = std::chrono::steady_clock::now();
+
+        if (deadline > now) {
+            std::this_thread::sleep_until(deadline);
+        }
+        else if (now - deadline > std::chrono::duration_cast<std::chrono::steady_clock::duration>(frameTime * 10)) {
+            resetClock(); // way behind (host too slow), don't rush through the missed frames
+        }
+    }
+
+    Chip8&   chip;
+    Engine&  engine;
+    unsigned instructionsPerFrame;
+    unsigned frameCycle = 0; // instructions executed in the current frame
+
+    uint64_t cycleCount = 0;
+    uint64_t frameCount = 0;
+
+    bool     idleSkipping = true;
+    uint64_t skippedCount = 0;
+
+    std::function<void()> frameHook;
+
+#if CHIP8_PROFILE
+    Profile*      profile = nullptr;
+    uint64_t      profileInterval = 0;
+    std::ostream* profileReport = nullptr;
+    std::chrono::steady_clock::duration frameTime = {};
+#endif
+
+    Pacing   pacing = Pacing::RealTime;
+    double   multiple = 1.0;
+    std::chrono::steady_clock::time_point clockStart = std::chrono::steady_clock::now();
+    uint64_t clockFrames = 0;
+};
@@ -0,0 +1,71 @@
+#include "SdlAudio.h"
+
+#include <iostream>
+
+// the include path of the Visual Studio project (see Main.cpp), else the one of sdl2-config --cflags
+#if __has_include("sdl2/SDL.h")
+#include "sdl2/SDL.h"
+#else
+#include <SDL.h>
+#endif
+
+
+SdlAudio::SdlAudio(AudioStream& stream, int bufferSamples)
+    : stream(stream)
+    , bufferSamples(bufferSamples)
+{
+}
+
+SdlAudio::~SdlAudio()
+{
+    close();
+}
+
+bool SdlAudio::open()
+{
+    SDL_AudioSpec wanted;
+    SDL_zero(wanted);
+    wanted.freq     = stream.rate();
+    wanted.format   = AUDIO_S16SYS;
+    wanted.channels = 1;
+    wanted.samples  = Uint16(bufferSamples);
+    wanted.callback = callback;
+    wanted.userdata = this;
+
+    // SDL converts if the device wants another format, the callback always gets mono S16 at our rate
+    SDL_AudioSpec obtained;
+    device = SDL_OpenAudioDevice(nullptr, 0, &wanted, &obtained, SDL_AUDIO_ALLOW_SAMPLES_CHANGE);
+    if (device == 0) {
+        std::cout << "SDL: Open audio device ; error ==" << SDL_GetError() << '\n';
+        return false;
+    }
+
+    obtainedSamples = obtained.samples;
+    obtainedRate = obtained.freq;
+
+    // ALLOW_SAMPLES_CHANGE: the buffer can be larger than asked for, the stream has to keep up with it
+    stream.fitDevice(obtained.samples);
+
+    SDL_PauseAudioDevice(device, 0);
+    return true;
+}
+
+void SdlAudio::close()
+{
+    if (device != 0) {
+        SDL_CloseAudioDevice(device);
+        device = 0;
+    }
+}
+
+double SdlAudio::deviceLatency() const
+{
+    return device != 0 && obtainedRate > 0 ? double(obtainedSamples) / obtainedRate : 0.0;
+}
+
+// the audio thread, only pull() happens here
+void SdlAudio::callback(void* user, uint8_t* bytes, int length)
+{
+    auto self = static_cast<SdlAudio*>(user);
+    self->stream.pull(reinterpret_cast<Sample*>(bytes), std::size_t(length) / sizeof(Sample));
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "Sound.h"
+
+// Plays an AudioStream on the default SDL audio device. SDL has to be initialised with SDL_INIT_AUDIO.
+// Works with every SDL audio driver, SDL_AUDIODRIVER=dummy or =disk run it without sound hardware.
+class SdlAudio {
+public:
+    // 'bufferSamples' per callback, a power of two; smaller == less latency, more callbacks
+    explicit SdlAudio(AudioStream& stream, int bufferSamples = 128);
+    ~SdlAudio();
+
+    SdlAudio(SdlAudio const&) = delete;
+    SdlAudio& operator = (SdlAudio const&) = delete;
+
+    // false if there is no device, the reason is written to std::cout
+    bool open();
+    void close();
+
+    // seconds a sample spends in the device buffer, 0 if not open
+    double deviceLatency() const;
+
+private:
+    static void callback(void* user, uint8_t* bytes, int length);
+
+    AudioStream& stream;
+    int          bufferSamples;
+    uint32_t     device = 0;
+    int          obtainedSamples = 0;
+    int          obtainedRate = 0;
+};
@@ -0,0 +1,87 @@
+#include "Sound.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+Sound sound(Chip8 const& c)
+{
+    Sound s;
+    s.on = c.soundTimer > 0;
+    return s;
+}
+
+Sound sound(ExtendedChip8 const& c)
+{
+    Sound s;
+    s.on = c.soundTimer > 0;
+    s.pattern = c.extension == Extension::XoChip && std::any_of(c.pattern.begin(), c.pattern.end(), [](Byte b) { return b != 0; });
+    s.bits = c.pattern;
+    s.pitch = c.pitch;
+    return s;
+}
+
+void Synth::render(Sound const& sound, Sample* out, std::size_t count)
+{
+    if (!sound.on) {
+        std::fill(out, out + count, Sample(0));
+        phase = 0;
+        return;
+    }
+
+    if (sound.pattern) {
+        const double step = 4000.0 * std::pow(2.0, (sound.pitch - 64) / 48.0) / sampleRate;
+        for (std::size_t n = 0; n < count; ++n) {
+            const int bit = int(phase) & 127;
+            out[n] = (sound.bits[bit >> 3] >> (7 - (bit & 7))) & 1 ? Amplitude : Sample(-Amplitude);
+            phase = std::fmod(phase + step, 128.0);
+        }
+        return;
+    }
+
+    const double step = BeepFrequency / sampleRate;
+    for (std::size_t n = 0; n < count; ++n) {
+        out[n] = phase < 0.5 ? Amplitude : Sample(-Amplitude);
+        phase = std::fmod(phase + step, 1.0);
+    }
+}
+
+AudioStream::AudioStream(int sampleRate, double latency)
+    : sampleRate(sampleRate)
+    , target(std::size_t(sampleRate * latency))
+    , synth(sampleRate)
+    , ring(std::make_unique<SpscRing<Sample>>(std::max<std::size_t>(target, 1) * 2))
+{
+}
+
+void AudioStream::fitDevice(std::size_t deviceSamples)
+{
+    // a callback takes a whole device buffer at once, the ring has to hold that and half of it more
+    // for pump() to catch up, or every callback runs into an underrun
+    const std::size_t needed = deviceSamples + deviceSamples / 2;
+    if (needed <= target) {
+        return;
+    }
+    target = needed;
+    ring = std::make_unique<SpscRing<Sample>>(target * 2);
+}
+
+void AudioStream::pump()
+{
+    std::size_t missing = target - std::min(target, ring->size());
+    while (missing > 0) {
+        const std::size_t count = std::min(missing, scratch.size());
+        synth.render(current, scratch.data(), count);
+        ring->push(scratch.data(), count);
+        missing -= count;
+    }
+}
+
+void AudioStream::pull(Sample* out, std::size_t count)
+{
+    const std::size_t got = ring->pop(out, count);
+    if (got < count) {
+        std::fill(out + got, out + count, Sample(0));
+        underrunCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "Chip8.h"
+#include "Extended.h"
+#include "SpscRing.h"
+
+// PCM audio from the sound timer, no SDL involved (see SdlAudio.h for the output).
+// The samples are made on the emulation thread and handed to the audio thread by an SpscRing.
+
+using Sample = int16_t; // mono, signed 16 bit
+
+// what a machine wants to sound like right now
+struct Sound {
+    bool      on = false;      // soundTimer > 0
+    bool      pattern = false; // XO-CHIP: play 'bits' instead of the beep
+    Bytes<16> bits = {};       // 128 samples of 1 bit, the highest bit first
+    Byte      pitch = 64;      // 'bits' are played at 4000 * 2^((pitch - 64) / 48) Hz
+};
+
+Sound sound(Chip8 const& c);
+Sound sound(ExtendedChip8 const& c); // the pattern of an XO-CHIP rom once it has set one (F002), the beep before
+
+// Square wave beep or XO-CHIP pattern; the phase runs on across calls, so there are no clicks
+// where one rendered block ends and the next begins.
+class Synth {
+public:
+    static constexpr double BeepFrequency = 440.0;
+    static constexpr Sample Amplitude = 4000;
+
+    explicit Synth(int sampleRate) : sampleRate(sampleRate) {}
+
+    void render(Sound const& sound, Sample* out, std::size_t count);
+
+private:
+    int    sampleRate;
+    double phase = 0; // beep: in periods, pattern: in bits
+};
+
+// The audio of one machine, from the emulation to the audio callback.
+// The ring is kept filled up to 'latency' seconds: pump() renders only what the consumer took since
+// the last call, so the samples in flight never grow beyond latency + the device buffer, however fast
+// the emulation runs. 'latency' has to be larger than one device buffer (fitDevice() raises it when
+// the device got a larger one), and pump() has to be called more often than the callback empties
+// the ring (every 1-2 ms). With the defaults and a device buffer of 128 samples that is 5 + 2.7 ms.
+class AudioStream {
+public:
+    explicit AudioStream(int sampleRate = 48000, double latency = 0.005);
+
+    // the buffer the device actually got; before the audio thread starts pulling
+    void fitDevice(std::size_t deviceSamples);
+
+    // emulation thread
+    void set(Sound const& value) { current = value; }
+    void pump();
+
+    // audio thread: fills 'out' completely, silence after an underrun; never locks or allocates
+    void pull(Sample* out, std::size_t count);
+
+    int         rate() const { return sampleRate; }
+    std::size_t queued() const { return ring->size(); } // samples between pump() and pull()
+    uint64_t    underruns() const { return underrunCount.load(std::memory_order_relaxed); }
+
+private:
+    int         sampleRate;
+    std::size_t target;     // samples pump() keeps in the ring
+    Synth       synth;
+    Sound       current;
+
+    std::unique_ptr<SpscRing<Sample>> ring;
+    std::array<Sample, 256> scratch = {}; // pump() renders through this, no allocation per call
+
+    std::atomic<uint64_t> underrunCount{ 0 }; // pull() calls that found too few samples
+};
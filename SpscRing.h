@@ -0,0 +1,96 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Lock-free ring buffer for exactly one producer and one consumer thread.
+// The buffer is allocated once in the constructor; push and pop never lock, wait or allocate,
+// so the consumer can be a real-time thread (the audio callback).
+// head and tail only ever grow, the index into the buffer is taken modulo the (power of two) capacity.
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(std::size_t minimumCapacity)
+    {
+        std::size_t capacity = 1;
+        while (capacity < minimumCapacity) {
+            capacity *= 2;
+        }
+        buffer.resize(capacity);
+        mask = capacity - 1;
+    }
+
+    SpscRing(SpscRing const&) = delete;
+    SpscRing& operator = (SpscRing const&) = delete;
+
+    // producer: appends up to 'count' items, returns how many fit
+    std::size_t push(T const* items, std::size_t count)
+    {
+        const std::size_t h = head.load(std::memory_order_relaxed);
+        const std::size_t t = tail.load(std::memory_order_acquire);
+        count = std::min(count, buffer.size() - (h - t));
+
+        for (std::size_t n = 0; n < count; ++n) {
+            buffer[(h + n) & mask] = items[n];
+        }
+        head.store(h + count, std::memory_order_release);
+        return count;
+    }
+
+    // consumer: takes up to 'count' items, returns how many there were
+    std::size_t pop(T* items, std::size_t count)
+    {
+        const std::size_t t = tail.load(std::memory_order_relaxed);
+        const std::size_t h = head.load(std::memory_order_acquire);
+        count = std::min(count, h - t);
+
+        for (std::size_t n = 0; n < count; ++n) {
+            items[n] = buffer[(t + n) & mask];
+        }
+        tail.store(t + count, std::memory_order_release);
+        return count;
+    }
+
+    // In place, for items too big to copy twice: the producer fills claim() (nullptr if the ring is
+    // full) and hands it over with commit(), the consumer reads front() (nullptr if the ring is empty)
+    // and gives it back with release().
+    T* claim()
+    {
+        const std::size_t h = head.load(std::memory_order_relaxed);
+        return h - tail.load(std::memory_order_acquire) < buffer.size() ? &buffer[h & mask] : nullptr;
+    }
+
+    void commit()
+    {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    T const* front() const
+    {
+        const std::size_t t = tail.load(std::memory_order_relaxed);
+        return head.load(std::memory_order_acquire) != t ? &buffer[t & mask] : nullptr;
+    }
+
+    void release()
+    {
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // exact for the calling side, a snapshot for the other one
+    std::size_t size() const
+    {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    std::size_t capacity() const { return buffer.size(); }
+
+private:
+    std::vector<T> buffer;
+    std::size_t    mask = 0;
+
+    // on their own cache lines, producer and consumer don't invalidate each other's line on every access
+    alignas(64) std::atomic<std::size_t> head{ 0 }; // written by the producer
+    alignas(64) std::atomic<std::size_t> tail{ 0 }; // written by the consumer
+};
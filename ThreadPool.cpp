@@ -0,0 +1,102 @@
+#include "ThreadPool.h"
+
+
+ThreadPool::ThreadPool(unsigned threads)
+{
+    if (threads == 0) {
+        threads = 1;
+    }
+
+    for (unsigned n = 0; n < threads; ++n) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (unsigned n = 0; n < threads; ++n) {
+        workers.emplace_back([this, n] { work(n); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    wake.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    auto& queue = *queues[next++ % queues.size()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+
+    pending++;
+    {
+        // taking the lock makes sure a worker can't miss the notification between its check and its wait
+        std::lock_guard<std::mutex> lock(mutex);
+        queued++;
+    }
+    wake.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this] { return pending == 0; });
+}
+
+bool ThreadPool::pop(unsigned self, Task& task)
+{
+    // own queue first, newest task
+    {
+        auto& queue = *queues[self];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+            return true;
+        }
+    }
+
+    // steal the oldest task of somebody else
+    for (std::size_t n = 1; n < queues.size(); ++n) {
+        auto& queue = *queues[(self + n) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::work(unsigned self)
+{
+    for (;;) {
+        Task task;
+        if (pop(self, task)) {
+            queued--;
+            task();
+
+            if (--pending == 0) {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [this] { return stop || queued > 0; });
+        if (stop && queued == 0) {
+            return;
+        }
+    }
+}
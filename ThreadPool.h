@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed number of workers, each with its own task queue. A worker takes the newest task from
+// its own queue and steals the oldest one from another queue when its own is empty,
+// so long and short tasks even out without a central queue everybody fights over.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threads = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    ThreadPool(ThreadPool const&) = delete;
+    ThreadPool& operator = (ThreadPool const&) = delete;
+
+    void submit(std::function<void()> task);
+
+    // blocks until every submitted task has finished
+    void wait();
+
+    unsigned size() const { return unsigned(workers.size()); }
+
+private:
+    using Task = std::function<void()>;
+
+    struct Queue {
+        std::mutex       mutex;
+        std::deque<Task> tasks;
+    };
+
+    bool pop(unsigned self, Task& task);
+    void work(unsigned self);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread>            workers;
+
+    std::mutex              mutex;
+    std::condition_variable wake;     // a task got submitted or the pool stops
+    std::condition_variable finished; // the last pending task finished
+
+    std::atomic<std::size_t> queued{ 0 };  // submitted, not started yet
+    std::atomic<std::size_t> pending{ 0 }; // submitted, not finished yet
+    std::atomic<unsigned>    next{ 0 };    // round robin target of submit()
+    bool                     stop = false;
+};
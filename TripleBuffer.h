@@ -0,0 +1,46 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Hands the newest complete T from one producer thread to one consumer thread without locks.
+// Three buffers: the producer writes 'back', the consumer reads 'front', the third one is in the
+// middle and holds the newest published T. publish() and update() swap their own buffer with the
+// middle one in a single atomic exchange, so neither side ever waits for the other.
+// Ts that were published while the consumer was busy are skipped, only the newest one is seen.
+template <typename T>
+class TripleBuffer {
+public:
+    // producer: the buffer to fill, then publish()
+    T& back() { return buffers[backIndex]; }
+
+    void publish()
+    {
+        backIndex = middle.exchange(Byte(backIndex | Fresh), std::memory_order_acq_rel) & Index;
+    }
+
+    // consumer: true if something was published since the last call, front() is the newest T then
+    bool update()
+    {
+        if (!(middle.load(std::memory_order_relaxed) & Fresh)) {
+            return false;
+        }
+        frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & Index;
+        return true;
+    }
+
+    T const& front() const { return buffers[frontIndex]; }
+
+private:
+    using Byte = uint8_t;
+
+    static constexpr Byte Index = 0x3;
+    static constexpr Byte Fresh = 0x4; // set in 'middle' by publish(), cleared by update()
+
+    std::array<T, 3> buffers = {};
+
+    alignas(64) std::atomic<Byte> middle{ 1 };
+    alignas(64) Byte backIndex = 0;  // producer only
+    alignas(64) Byte frontIndex = 2; // consumer only
+};